@@ -30,6 +30,23 @@
 #define RV32EMU_DEFAULT_HART_COUNT 1u
 #define RV32EMU_MAX_HARTS 4u
 #define RV32EMU_MAX_PLIC_CONTEXTS (RV32EMU_MAX_HARTS * 2u)
+#define RV32EMU_DEFAULT_TLB_ENTRIES 64u
+#define RV32EMU_DEFAULT_TIMER_BATCH 64u
+#define RV32EMU_TIMER_BATCH_MAX 65536u
+#define RV32EMU_DEFAULT_TIMEBASE_HZ 10000000u
+#define RV32EMU_HOST_CLOCK_POLL_INSNS 1024u
+#define RV32EMU_WFI_PARK_MAX_NS 10000000ull /* callers of rv32emu_run regain control this often */
+#define RV32EMU_TLB_MAX_ENTRIES 256u
+#define RV32EMU_MTLB_ENTRIES 8u
+#define RV32EMU_PWC_ENTRIES 16u
+
+/*
+ * Pending fence request word: 0, RV32EMU_FENCE_ALL, a page vaddr | RV32EMU_FENCE_PAGE,
+ * or (asid << 12) | RV32EMU_FENCE_ASID.
+ */
+#define RV32EMU_FENCE_ALL 1u
+#define RV32EMU_FENCE_PAGE 2u
+#define RV32EMU_FENCE_ASID 4u
 
 typedef enum {
   RV32EMU_PRIV_U = 0,
@@ -43,6 +60,18 @@ typedef enum {
   RV32EMU_ACC_STORE = 2,
 } rv32emu_access_t;
 
+typedef enum {
+  RV32EMU_AMO_SWAP = 0,
+  RV32EMU_AMO_ADD,
+  RV32EMU_AMO_XOR,
+  RV32EMU_AMO_AND,
+  RV32EMU_AMO_OR,
+  RV32EMU_AMO_MIN,
+  RV32EMU_AMO_MAX,
+  RV32EMU_AMO_MINU,
+  RV32EMU_AMO_MAXU,
+} rv32emu_amo_op_t;
+
 enum {
   RV32EMU_EXC_INST_MISALIGNED = 0,
   RV32EMU_EXC_INST_ACCESS_FAULT = 1,
@@ -147,6 +176,71 @@ enum {
   PTE_D = 1u << 7,
 };
 
+typedef struct rv32emu_machine rv32emu_machine_t;
+
+/*
+ * Device access callbacks used by the physical memory map. `paddr` is the
+ * absolute physical address; `opaque` is the pointer given at registration.
+ */
+typedef bool (*rv32emu_mmio_read_fn)(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                     uint32_t *out);
+typedef bool (*rv32emu_mmio_write_fn)(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                      uint32_t data);
+
+#define RV32EMU_PHYS_MAX_REGIONS 16u
+#define RV32EMU_PHYS_L1_SHIFT 22u
+#define RV32EMU_PHYS_L1_ENTRIES 1024u
+#define RV32EMU_PHYS_L2_ENTRIES 1024u
+
+/*
+ * One registered physical region: RAM when `host` is set, a device otherwise.
+ * `lock` is held around device callbacks; NULL means the device synchronizes
+ * its own state (lock-free or finer-grained locks).
+ */
+typedef struct {
+  const char *name;
+  uint32_t base;
+  uint32_t size;
+  uint8_t *host;
+  rv32emu_mmio_read_fn read;
+  rv32emu_mmio_write_fn write;
+  void *opaque;
+  pthread_mutex_t *lock;
+} rv32emu_phys_region_t;
+
+/*
+ * Two-level page map of the 32-bit physical space. A 4 MiB slot owned by a
+ * single region points at it directly (`block`); mixed slots get a lazily
+ * allocated table of per-4 KiB region pointers.
+ */
+typedef struct {
+  const rv32emu_phys_region_t *block;
+  const rv32emu_phys_region_t **pages;
+} rv32emu_phys_slot_t;
+
+typedef struct {
+  rv32emu_phys_region_t regions[RV32EMU_PHYS_MAX_REGIONS];
+  uint32_t region_count;
+  rv32emu_phys_slot_t slots[RV32EMU_PHYS_L1_ENTRIES];
+} rv32emu_phys_map_t;
+
+/*
+ * Guest DRAM backing. Anonymous/THP mappings use MAP_NORESERVE so only pages
+ * the guest touches are committed; hugetlb draws from the host's reserved pool.
+ */
+typedef enum {
+  RV32EMU_DRAM_BACKING_ANON = 0,    /* 4 KiB host pages */
+  RV32EMU_DRAM_BACKING_THP = 1,     /* madvise(MADV_HUGEPAGE) */
+  RV32EMU_DRAM_BACKING_HUGETLB = 2, /* MAP_HUGETLB from the hugetlbfs pool */
+  RV32EMU_DRAM_BACKING_MEMFD = 3,   /* shared memfd, so pages can be mapped twice (plat.dram_fd) */
+} rv32emu_dram_backing_t;
+
+/* Where CLINT mtime comes from. */
+typedef enum {
+  RV32EMU_MTIME_INSTRET = 0, /* one tick per retired instruction (deterministic) */
+  RV32EMU_MTIME_HOST = 1,    /* CLOCK_MONOTONIC scaled to opts.timebase_hz */
+} rv32emu_mtime_source_t;
+
 typedef struct {
   const char *kernel_path;
   const char *dtb_path;
@@ -161,21 +255,49 @@ typedef struct {
   bool enable_sbi_shim;
   bool trace;
   uint32_t hart_count;
+  uint32_t tlb_entries; /* per-hart I/D TLB size, power of two; 0 disables */
+  rv32emu_dram_backing_t dram_backing;
+  bool dirty_tracking; /* keep a per-4 KiB DRAM dirty map (rv32emu_dirty_*) */
+  bool flat_phys;      /* place DRAM in a 4 GiB guest-physical host window (64-bit hosts) */
+  uint32_t timer_batch; /* retired instructions a hart may keep off plat.mtime; 0/1 = exact */
+  rv32emu_mtime_source_t mtime_source;
+  uint32_t timebase_hz; /* mtime rate for RV32EMU_MTIME_HOST; must match the DTB */
   uint64_t max_instructions;
 } rv32emu_options_t;
 
+/*
+ * Per-hart CLINT state. `lock` orders msip/mtimecmp updates with the hart's
+ * mip timer/software bits; reads (guest polls, deadline scans) are lock-free.
+ */
+typedef struct {
+  pthread_mutex_t lock;
+  atomic_uint_fast64_t mtimecmp;
+  atomic_uint msip;
+} rv32emu_clint_hart_t;
+
 typedef struct {
   uint8_t *dram;
   uint32_t dram_base;
   uint32_t dram_size;
-  pthread_mutex_t dram_lock;
+  size_t dram_map_size;
+  uint8_t *phys_window; /* phys_window + paddr is DRAM's host byte; NULL unless flat_phys */
+  void *phys_window_map;
+  size_t phys_window_map_size;
+  rv32emu_dram_backing_t dram_backing; /* effective backing after fallback */
+  int dram_fd;                         /* memfd behind DRAM when dram_backing is MEMFD */
+  uint8_t *dirty_map; /* one byte per DRAM page, set on write; NULL when tracking is off */
+  uint32_t dirty_pages;
+  atomic_uint *code_version; /* per DRAM page; odd while translated code depends on it */
   pthread_mutex_t amo_lock;
-  pthread_mutex_t mmio_lock;
+  pthread_mutex_t uart_lock; /* UART registers + RX FIFO */
+  pthread_mutex_t plic_lock; /* PLIC pending/enable/claim; taken after uart_lock */
   bool dram_atomic_stats_enable;
+  atomic_uint lr_live; /* harts holding an LR reservation; stores skip the scan at 0 */
 
   atomic_uint_fast64_t mtime;
-  uint64_t clint_mtimecmp[RV32EMU_MAX_HARTS];
-  uint32_t clint_msip[RV32EMU_MAX_HARTS];
+  atomic_uint_fast64_t mtime_offset; /* host mode: mtime = host ticks + offset (mod 2^64) */
+  bool park_ready;                   /* per-hart park_lock/park_cond initialized */
+  rv32emu_clint_hart_t clint[RV32EMU_MAX_HARTS];
   atomic_uint_fast64_t next_timer_deadline;
   atomic_uint_fast64_t dram_atomic_read_aligned32;
   atomic_uint_fast64_t dram_atomic_read_aligned16;
@@ -183,19 +305,61 @@ typedef struct {
   atomic_uint_fast64_t dram_atomic_write_aligned32;
   atomic_uint_fast64_t dram_atomic_write_aligned16;
   atomic_uint_fast64_t dram_atomic_write_bytepath;
+  atomic_uint_fast64_t tlb_hits;
+  atomic_uint_fast64_t tlb_misses;
+  atomic_uint_fast64_t pwc_hits;        /* TLB misses that skipped the level-1 PTE read */
+  atomic_uint_fast64_t idle_warps;      /* instret mtime jumps taken with every hart in wfi */
+  atomic_uint_fast64_t idle_warp_ticks; /* mtime ticks those jumps skipped */
+  atomic_uint_fast64_t spin_warps;      /* instret mtime jumps taken inside time-polling loops */
+  atomic_uint_fast64_t spin_warp_ticks; /* mtime ticks those jumps skipped */
+  atomic_uint_fast64_t lock_acquires;
+  atomic_uint_fast64_t lock_contended;
 
   uint32_t plic_pending;
   uint32_t plic_enable[RV32EMU_MAX_PLIC_CONTEXTS];
   uint32_t plic_claim[RV32EMU_MAX_PLIC_CONTEXTS];
 
+  rv32emu_phys_map_t phys_map;
+
   uint8_t uart_regs[8];
   uint8_t uart_rx_fifo[RV32EMU_UART_RX_FIFO_SIZE];
   uint16_t uart_rx_head;
   uint16_t uart_rx_tail;
   uint16_t uart_rx_count;
   bool uart_tx_irq_pending;
+  atomic_bool uart_irq_level; /* UART line into the PLIC, sampled without uart_lock */
 } rv32emu_platform_t;
 
+/*
+ * One cached Sv32 leaf translation (4 KiB granularity).
+ * `ctx` packs the effective privilege plus mstatus.SUM/MXR seen at fill time,
+ * `perm` holds the access kinds (1 << rv32emu_access_t) the walk proved legal,
+ * `host_page` is the host address of the page when it is DRAM, else NULL.
+ * Megapage entries (cpu->mtlb) use the same layout at 4 MiB granularity:
+ * vpn/ppn are vaddr >> 22 / paddr >> 22 and host_page covers all 4 MiB.
+ */
+typedef struct {
+  uint8_t *host_page;
+  uint32_t vpn;
+  uint32_t ppn;
+  uint32_t satp;
+  uint8_t ctx;
+  uint8_t perm;
+  bool valid;
+} rv32emu_tlb_entry_t;
+
+/*
+ * One cached non-leaf level-1 PTE: the level-0 table that (satp, vpn1)
+ * points at. Non-leaf PTEs carry no A/D state, so reusing one skips only
+ * the read; leaf A/D updates still happen on the level-0 PTE.
+ */
+typedef struct {
+  uint32_t satp;
+  uint32_t table;
+  uint16_t vpn1;
+  bool valid;
+} rv32emu_pwc_entry_t;
+
 typedef struct {
   uint32_t x[32];
   uint64_t f[32];
@@ -208,14 +372,35 @@ typedef struct {
   bool trace;
 
   uint32_t lr_addr;
+  uint32_t lr_value; /* word loaded by lr.w; sc.w commits by CAS against it */
+  bool code_written;  /* last store hit a page backing translated code */
   atomic_bool lr_valid;
   atomic_uint_fast32_t mip;
-  uint32_t timer_batch_ticks;
+  atomic_bool irq_check; /* an interrupt may be deliverable or a fence is posted */
+  atomic_uint tlb_fence; /* sfence.vma posted by another hart (SBI rfence) */
+  atomic_uint tb_fence;  /* translated code to drop: fence.i, sfence.vma, SBI rfence */
+  uint32_t timer_batch_ticks; /* retired ticks not yet added to plat.mtime */
+  uint32_t timer_batch_limit; /* flush when ticks reach this (cap or next deadline) */
+  bool wfi_idle;              /* retired wfi with nothing to wake it yet */
+  atomic_bool wfi_parked;     /* owner thread blocked on park_cond; wakers must signal */
+
+  rv32emu_tlb_entry_t itlb[RV32EMU_TLB_MAX_ENTRIES];
+  rv32emu_tlb_entry_t dtlb[RV32EMU_TLB_MAX_ENTRIES];
+  rv32emu_tlb_entry_t mtlb[RV32EMU_MTLB_ENTRIES]; /* level-1 leaves, fully associative */
+  uint8_t mtlb_next;                              /* round-robin fill slot */
+  rv32emu_pwc_entry_t pwc[RV32EMU_PWC_ENTRIES];   /* page-walk cache, indexed by vpn1 */
 
   uint32_t csr[4096];
+
+  /* Host-side state: SBI hart_start clears only the fields above. */
+  atomic_bool worker_bound; /* a threaded rv32emu_run worker executes this hart */
+  atomic_uint fence_seq;    /* bumped by SBI rfence after posting into the fence words */
+  atomic_uint fence_ack;    /* last fence_seq whose TLB fence has been applied */
+  pthread_mutex_t park_lock;
+  pthread_cond_t park_cond;
 } rv32emu_cpu_t;
 
-typedef struct {
+struct rv32emu_machine {
   rv32emu_options_t opts;
   rv32emu_platform_t plat;
   union {
@@ -226,7 +411,7 @@ typedef struct {
   uint32_t active_hart;
   rv32emu_cpu_t *cpu_cur;
   bool threaded_exec_active;
-} rv32emu_machine_t;
+};
 
 extern _Thread_local rv32emu_machine_t *rv32emu_tls_machine;
 extern _Thread_local rv32emu_cpu_t *rv32emu_tls_cpu;
@@ -328,18 +513,36 @@ static inline uint32_t rv32emu_cpu_mip_load(const rv32emu_cpu_t *cpu) {
   return (uint32_t)atomic_load_explicit(&cpu->mip, memory_order_relaxed);
 }
 
+/*
+ * Raise irq_check after changing mip, mie, mstatus, mideleg or priv, or
+ * posting a TLB fence. rv32emu_check_pending_interrupt() only scans while it
+ * is set; seq_cst pairs with the exchange there, so a change racing with a
+ * scan is either seen by it or leaves the flag set for the next one.
+ */
+static inline void rv32emu_cpu_irq_recheck(rv32emu_cpu_t *cpu) {
+  atomic_store_explicit(&cpu->irq_check, true, memory_order_seq_cst);
+}
+
 static inline void rv32emu_cpu_mip_store(rv32emu_cpu_t *cpu, uint32_t value) {
   if (cpu == NULL) {
     return;
   }
   atomic_store_explicit(&cpu->mip, value, memory_order_relaxed);
+  rv32emu_cpu_irq_recheck(cpu);
 }
 
+void rv32emu_hart_wake(rv32emu_cpu_t *cpu);
+
 static inline void rv32emu_cpu_mip_set_bits(rv32emu_cpu_t *cpu, uint32_t mask) {
   if (cpu == NULL) {
     return;
   }
-  atomic_fetch_or_explicit(&cpu->mip, mask, memory_order_relaxed);
+  /* seq_cst pairs with rv32emu_hart_park(): either it sees the bit or we see it parked. */
+  atomic_fetch_or_explicit(&cpu->mip, mask, memory_order_seq_cst);
+  rv32emu_cpu_irq_recheck(cpu);
+  if (atomic_load_explicit(&cpu->wfi_parked, memory_order_seq_cst)) {
+    rv32emu_hart_wake(cpu);
+  }
 }
 
 static inline void rv32emu_cpu_mip_clear_bits(rv32emu_cpu_t *cpu, uint32_t mask) {
@@ -349,6 +552,29 @@ static inline void rv32emu_cpu_mip_clear_bits(rv32emu_cpu_t *cpu, uint32_t mask)
   atomic_fetch_and_explicit(&cpu->mip, ~mask, memory_order_relaxed);
 }
 
+/*
+ * LR reservation transitions. lr_valid flips via exchange so exactly one
+ * party (owner or an invalidating hart) accounts for each set/clear in
+ * plat.lr_live.
+ */
+static inline void rv32emu_lr_clear(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
+  if (atomic_load_explicit(&cpu->lr_valid, memory_order_relaxed) &&
+      atomic_exchange_explicit(&cpu->lr_valid, false, memory_order_acq_rel)) {
+    atomic_fetch_sub_explicit(&m->plat.lr_live, 1u, memory_order_release);
+  }
+}
+
+static inline void rv32emu_lr_set(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_t addr) {
+  rv32emu_lr_clear(m, cpu);
+  cpu->lr_addr = addr;
+  atomic_fetch_add_explicit(&m->plat.lr_live, 1u, memory_order_seq_cst);
+  atomic_store_explicit(&cpu->lr_valid, true, memory_order_seq_cst);
+}
+
+static inline uint64_t rv32emu_clint_mtimecmp(const rv32emu_machine_t *m, uint32_t hart) {
+  return atomic_load(&m->plat.clint[hart].mtimecmp);
+}
+
 static inline uint64_t rv32emu_timer_next_deadline(const rv32emu_machine_t *m) {
   uint64_t next = UINT64_MAX;
   uint64_t mtime;
@@ -360,7 +586,7 @@ static inline uint64_t rv32emu_timer_next_deadline(const rv32emu_machine_t *m) {
 
   mtime = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
   for (hart = 0u; hart < m->hart_count; hart++) {
-    uint64_t cmp = m->plat.clint_mtimecmp[hart];
+    uint64_t cmp = rv32emu_clint_mtimecmp(m, hart);
 
     /*
      * Only future comparators are candidates for the next event.
@@ -376,11 +602,104 @@ static inline uint64_t rv32emu_timer_next_deadline(const rv32emu_machine_t *m) {
 }
 
 static inline void rv32emu_timer_refresh_deadline(rv32emu_machine_t *m) {
+  uint64_t next;
+  uint64_t again;
+
   if (m == NULL) {
     return;
   }
-  atomic_store_explicit(&m->plat.next_timer_deadline, rv32emu_timer_next_deadline(m),
-                        memory_order_relaxed);
+
+  /*
+   * Comparators of different harts are written under different locks, so a
+   * racing refresh may publish a stale minimum. Republish until a rescan
+   * agrees: the last writer to store always saw every earlier comparator.
+   */
+  next = rv32emu_timer_next_deadline(m);
+  for (;;) {
+    atomic_store(&m->plat.next_timer_deadline, next);
+    again = rv32emu_timer_next_deadline(m);
+    if (again == next) {
+      return;
+    }
+    next = again;
+  }
+}
+
+/*
+ * Platform mutex wrappers. Acquisitions are counted under the same debug gate
+ * as the dram atomic stats so lock traffic per retired instruction can be
+ * compared across memory-access modes; `lock_contended` counts acquisitions
+ * that found the lock already held by another hart.
+ */
+static inline bool rv32emu_plat_lock(rv32emu_machine_t *m, pthread_mutex_t *lock) {
+  if (!m->plat.dram_atomic_stats_enable) {
+    return pthread_mutex_lock(lock) == 0;
+  }
+  if (pthread_mutex_trylock(lock) != 0) {
+    atomic_fetch_add_explicit(&m->plat.lock_contended, 1u, memory_order_relaxed);
+    if (pthread_mutex_lock(lock) != 0) {
+      return false;
+    }
+  }
+  atomic_fetch_add_explicit(&m->plat.lock_acquires, 1u, memory_order_relaxed);
+  return true;
+}
+
+static inline void rv32emu_plat_unlock(pthread_mutex_t *lock) {
+  (void)pthread_mutex_unlock(lock);
+}
+
+/*
+ * Dirty-page tracking: every committed DRAM write sets the byte of each 4 KiB
+ * page it touches. Marking is one relaxed byte store, cheap enough to leave on;
+ * rv32emu_dirty_scan() reports and optionally clears the set pages.
+ */
+static inline void rv32emu_dirty_mark(rv32emu_machine_t *m, uint32_t paddr, uint32_t len) {
+  uint8_t *map = m->plat.dirty_map;
+  uint32_t off = paddr - m->plat.dram_base;
+  uint32_t last;
+
+  if (map == NULL || off >= m->plat.dram_size || len == 0u) {
+    return;
+  }
+  last = (len - 1u > m->plat.dram_size - 1u - off) ? m->plat.dram_size - 1u : off + len - 1u;
+  for (uint32_t page = off >> 12; page <= (last >> 12); page++) {
+    __atomic_store_n(&map[page], (uint8_t)1u, __ATOMIC_RELAXED);
+  }
+}
+
+/*
+ * Translated-code write tracking: TB lines register the DRAM pages they decode
+ * from (rv32emu_code_watch_page makes the page's counter odd) and keep the
+ * value; the next write to such a page bumps it back to even, so a line is
+ * current iff its saved value still matches. Writes to pages without
+ * translated code cost one relaxed load.
+ */
+static inline void rv32emu_code_note_write(rv32emu_machine_t *m, uint32_t paddr, uint32_t len) {
+  atomic_uint *version = m->plat.code_version;
+  uint32_t off = paddr - m->plat.dram_base;
+  uint32_t last;
+
+  if (version == NULL || off >= m->plat.dram_size || len == 0u) {
+    return;
+  }
+  last = (len - 1u > m->plat.dram_size - 1u - off) ? m->plat.dram_size - 1u : off + len - 1u;
+  for (uint32_t page = off >> 12; page <= (last >> 12); page++) {
+    if ((atomic_load_explicit(&version[page], memory_order_relaxed) & 1u) != 0u) {
+      rv32emu_cpu_t *cpu = RV32EMU_CPU(m);
+
+      atomic_fetch_add_explicit(&version[page], 1u, memory_order_release);
+      if (cpu != NULL) {
+        cpu->code_written = true;
+      }
+    }
+  }
+}
+
+/* Every committed DRAM write goes through here: dirty map plus code versions. */
+static inline void rv32emu_note_dram_write(rv32emu_machine_t *m, uint32_t paddr, uint32_t len) {
+  rv32emu_dirty_mark(m, paddr, len);
+  rv32emu_code_note_write(m, paddr, len);
 }
 
 static inline bool rv32emu_any_hart_running(const rv32emu_machine_t *m) {
@@ -406,27 +725,124 @@ void rv32emu_platform_destroy(rv32emu_machine_t *m);
 
 uint8_t *rv32emu_dram_ptr(rv32emu_machine_t *m, uint32_t paddr, size_t len);
 
+/*
+ * Host address of a DRAM page (page-aligned paddr), else NULL: one compare
+ * and one add. Callers on the per-access path use this instead of
+ * rv32emu_dram_ptr(). With the flat window this is phys_window + page.
+ */
+static inline uint8_t *rv32emu_dram_page(const rv32emu_machine_t *m, uint32_t page) {
+  if (page - m->plat.dram_base >= m->plat.dram_size) {
+    return NULL;
+  }
+  return m->plat.dram + (page - m->plat.dram_base);
+}
+
+/*
+ * Flat window (opts.flat_phys): DRAM is phys_window + paddr. The compare
+ * only keeps MMIO and accesses running past the end of DRAM off the window,
+ * where everything but DRAM is a PROT_NONE guard; no phys_map lookup.
+ */
+static inline uint8_t *rv32emu_phys_flat_ptr(const rv32emu_machine_t *m, uint32_t paddr,
+                                             uint32_t len) {
+  if (m->plat.phys_window == NULL || paddr - m->plat.dram_base > m->plat.dram_size - len) {
+    return NULL;
+  }
+  return m->plat.phys_window + paddr;
+}
+
+typedef void (*rv32emu_dirty_page_fn)(void *opaque, uint32_t page_paddr);
+bool rv32emu_dirty_map_init(rv32emu_machine_t *m);
+void rv32emu_dirty_map_destroy(rv32emu_machine_t *m);
+bool rv32emu_code_version_init(rv32emu_machine_t *m);
+void rv32emu_code_version_destroy(rv32emu_machine_t *m);
+bool rv32emu_code_watch_page(rv32emu_machine_t *m, uint32_t paddr, uint32_t *page_out,
+                             uint32_t *version_out);
+uint32_t rv32emu_dirty_scan(rv32emu_machine_t *m, uint32_t paddr, uint32_t size, bool clear,
+                            rv32emu_dirty_page_fn fn, void *opaque);
+
+bool rv32emu_phys_map_ram(rv32emu_machine_t *m, const char *name, uint32_t base, uint32_t size,
+                          uint8_t *host);
+bool rv32emu_phys_map_device(rv32emu_machine_t *m, const char *name, uint32_t base, uint32_t size,
+                             rv32emu_mmio_read_fn read, rv32emu_mmio_write_fn write,
+                             void *opaque, pthread_mutex_t *lock);
+void rv32emu_phys_map_destroy(rv32emu_machine_t *m);
+bool rv32emu_mmio_register_devices(rv32emu_machine_t *m);
+
+static inline const rv32emu_phys_region_t *rv32emu_phys_lookup(const rv32emu_machine_t *m,
+                                                               uint32_t paddr) {
+  const rv32emu_phys_slot_t *slot = &m->plat.phys_map.slots[paddr >> RV32EMU_PHYS_L1_SHIFT];
+  const rv32emu_phys_region_t *region = slot->block;
+
+  if (region == NULL) {
+    if (slot->pages == NULL) {
+      return NULL;
+    }
+    region = slot->pages[(paddr >> 12) & (RV32EMU_PHYS_L2_ENTRIES - 1u)];
+    if (region == NULL) {
+      return NULL;
+    }
+  }
+  /* Sub-page devices (e.g. UART) only own the low part of their page. */
+  if (paddr - region->base >= region->size) {
+    return NULL;
+  }
+  return region;
+}
+
 bool rv32emu_phys_read(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out);
 bool rv32emu_phys_write(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data);
 bool rv32emu_uart_push_rx(rv32emu_machine_t *m, uint8_t data);
 
 void rv32emu_step_timer(rv32emu_machine_t *m);
+void rv32emu_advance_timer(rv32emu_machine_t *m, uint32_t ticks);
 void rv32emu_flush_timer(rv32emu_machine_t *m);
+void rv32emu_timer_rebase(rv32emu_machine_t *m);
+uint64_t rv32emu_timer_idle_ns(rv32emu_machine_t *m, uint64_t max_ns);
+bool rv32emu_timer_fast_forward(rv32emu_machine_t *m);
+uint64_t rv32emu_timer_spin_warp(rv32emu_machine_t *m, uint64_t ticks);
+bool rv32emu_hart_park_init(rv32emu_machine_t *m);
+void rv32emu_hart_park_destroy(rv32emu_machine_t *m);
+bool rv32emu_hart_wfi_wakeup(const rv32emu_cpu_t *cpu);
+bool rv32emu_hart_park(rv32emu_machine_t *m, rv32emu_cpu_t *cpu);
+bool rv32emu_harts_idle_wait(rv32emu_machine_t *m);
 
 bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t access,
                        uint32_t *paddr_out);
+bool rv32emu_translate_fetch(rv32emu_machine_t *m, uint32_t vaddr, bool probe, uint32_t *paddr_out,
+                             uint8_t **host_page_out);
+void rv32emu_tlb_flush(rv32emu_machine_t *m, rv32emu_cpu_t *cpu);
+void rv32emu_tlb_flush_page(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_t vaddr);
+void rv32emu_tlb_flush_walks(rv32emu_cpu_t *cpu);
+void rv32emu_tlb_sync_fence(rv32emu_machine_t *m, rv32emu_cpu_t *cpu);
+/* After posting to tlb_fence, call rv32emu_cpu_irq_recheck() on that hart. */
+void rv32emu_fence_post(atomic_uint *slot, uint32_t req);
 
 bool rv32emu_virt_read(rv32emu_machine_t *m, uint32_t vaddr, int len,
                        rv32emu_access_t access, uint32_t *out);
 bool rv32emu_virt_write(rv32emu_machine_t *m, uint32_t vaddr, int len,
                         rv32emu_access_t access, uint32_t data);
+bool rv32emu_virt_amo32(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_amo_op_t op,
+                        uint32_t operand, uint32_t *old_out);
+bool rv32emu_virt_cas32(rv32emu_machine_t *m, uint32_t vaddr, uint32_t expected,
+                        uint32_t desired, bool *swapped_out);
 
 uint32_t rv32emu_csr_read(rv32emu_machine_t *m, uint16_t csr_num);
 void rv32emu_csr_write(rv32emu_machine_t *m, uint16_t csr_num, uint32_t value);
 
 void rv32emu_raise_exception(rv32emu_machine_t *m, uint32_t cause, uint32_t tval);
 void rv32emu_raise_interrupt(rv32emu_machine_t *m, uint32_t cause_num);
-bool rv32emu_check_pending_interrupt(rv32emu_machine_t *m);
+bool rv32emu_scan_pending_interrupt(rv32emu_machine_t *m, rv32emu_cpu_t *cpu);
+
+/* Per-step interrupt check: a flag test unless something changed since the last scan. */
+static inline bool rv32emu_check_pending_interrupt(rv32emu_machine_t *m) {
+  rv32emu_cpu_t *cpu;
+
+  if (m == NULL || (cpu = RV32EMU_CPU(m)) == NULL ||
+      !atomic_load_explicit(&cpu->irq_check, memory_order_relaxed)) {
+    return false;
+  }
+  return rv32emu_scan_pending_interrupt(m, cpu);
+}
 
 bool rv32emu_handle_sbi_ecall(rv32emu_machine_t *m);
 
@@ -436,6 +852,13 @@ bool rv32emu_load_raw(rv32emu_machine_t *m, const char *path, uint32_t load_addr
                       uint32_t *size_out);
 bool rv32emu_load_elf32(rv32emu_machine_t *m, const char *path, uint32_t *entry_out);
 
+/*
+ * Returns the number of instructions retired, which may be fewer than
+ * max_instructions: with host-clock mtime the run ends once every hart has sat
+ * in WFI for a full RV32EMU_WFI_PARK_MAX_NS wait (so the caller can feed
+ * input), and it ends when no hart is running. Callers that want the whole
+ * budget loop until it is spent or every hart has stopped.
+ */
 int rv32emu_run(rv32emu_machine_t *m, uint64_t max_instructions);
 
 static inline uint32_t rv32emu_sign_extend(uint32_t value, int bits) {
@@ -8,8 +8,12 @@
 #define RV32EMU_TB_WAYS 2u
 #define RV32EMU_TB_TOTAL_LINES (RV32EMU_TB_LINES * RV32EMU_TB_WAYS)
 #define RV32EMU_TB_MAX_INSNS 32u
+#define RV32EMU_TB_MAX_CODE_PAGES 2u /* 32 insns never span more than two pages */
 
 typedef int (*rv32emu_tb_jit_fn_t)(rv32emu_machine_t *m, rv32emu_cpu_t *cpu);
+/* Executes and retires one decoded instruction; false if it trapped. */
+typedef bool (*rv32emu_tb_exec_fn_t)(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
+                                     const rv32emu_decoded_insn_t *d);
 
 typedef enum {
   RV32EMU_TB_JIT_NOPROGRESS = 0,
@@ -36,7 +40,14 @@ typedef struct {
 typedef struct {
   bool valid;
   uint32_t start_pc;
+  uint32_t ctx_satp; /* fetch context the line was decoded in, see rv32emu_tb_cache_sync() */
+  uint8_t ctx_priv;
   uint8_t count;
+  uint8_t code_page_count;
+  bool spin_loop;  /* branches back to start_pc, only side effect is reading the time */
+  bool spin_loads; /* spin_loop whose loads must be checked to hit CLINT mtime */
+  uint32_t code_page[RV32EMU_TB_MAX_CODE_PAGES];    /* DRAM page index the insns came from */
+  uint32_t code_version[RV32EMU_TB_MAX_CODE_PAGES]; /* plat.code_version seen at build */
   uint8_t jit_hotness;
   bool jit_tried;
   bool jit_valid;
@@ -53,15 +64,22 @@ typedef struct {
   uint32_t jit_chain_pc;
   rv32emu_tb_jit_fn_t jit_chain_fn;
   uint32_t pcs[RV32EMU_TB_MAX_INSNS];
+  rv32emu_tb_exec_fn_t exec[RV32EMU_TB_MAX_INSNS]; /* handler bound at build, see rv32emu_exec_bind() */
   rv32emu_decoded_insn_t decoded[RV32EMU_TB_MAX_INSNS];
 } rv32emu_tb_line_t;
 
 typedef struct {
   rv32emu_tb_line_t lines[RV32EMU_TB_TOTAL_LINES];
   uint8_t repl_next_way[RV32EMU_TB_LINES];
+  uint32_t ctx_satp; /* current fetch context; lines only match when theirs is equal */
+  uint8_t ctx_priv;
+  uint8_t ctx_mix; /* context hash folded into the set index */
   bool active;
   uint32_t active_start_pc;
   uint8_t active_index;
+  uint32_t spin_pc; /* spin_loop line being repeated, see rv32emu_tb_spin_iteration() */
+  uint32_t spin_iters;
+  uint32_t spin_step;
   uint8_t jit_hot_threshold;
   uint8_t jit_max_block_insns;
   uint8_t jit_min_prefix_insns;
@@ -80,6 +98,7 @@ typedef struct {
   uint8_t jit_async_drain_ticks;
 } rv32emu_tb_cache_t;
 
+rv32emu_tb_exec_fn_t rv32emu_exec_bind(const rv32emu_decoded_insn_t *d);
 void rv32emu_tb_cache_reset(rv32emu_tb_cache_t *cache);
 bool rv32emu_exec_one_tb(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache);
 rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache,
@@ -50,10 +50,6 @@ static void rv32emu_write_rd(rv32emu_machine_t *m, uint32_t rd, uint32_t value)
 static bool rv32emu_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t funct3,
                                uint32_t *value_out) {
   uint32_t raw = 0;
-  uint32_t b0 = 0;
-  uint32_t b1 = 0;
-  uint32_t b2 = 0;
-  uint32_t b3 = 0;
 
   switch (funct3) {
   case 0x0: /* lb */
@@ -63,32 +59,13 @@ static bool rv32emu_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t fun
     *value_out = rv32emu_sign_extend(raw & 0xffu, 8);
     return true;
   case 0x1: /* lh */
-    if ((addr & 1u) == 0u) {
-      if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
-        return false;
-      }
-    } else {
-      if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-          !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1)) {
-        return false;
-      }
-      raw = (b0 & 0xffu) | ((b1 & 0xffu) << 8);
+    if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
+      return false;
     }
     *value_out = rv32emu_sign_extend(raw & 0xffffu, 16);
     return true;
   case 0x2: /* lw */
-    if ((addr & 3u) == 0u) {
-      return rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, value_out);
-    }
-    if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-        !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1) ||
-        !rv32emu_virt_read(m, addr + 2u, 1, RV32EMU_ACC_LOAD, &b2) ||
-        !rv32emu_virt_read(m, addr + 3u, 1, RV32EMU_ACC_LOAD, &b3)) {
-      return false;
-    }
-    *value_out = (b0 & 0xffu) | ((b1 & 0xffu) << 8) | ((b2 & 0xffu) << 16) |
-                 ((b3 & 0xffu) << 24);
-    return true;
+    return rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, value_out);
   case 0x4: /* lbu */
     if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &raw)) {
       return false;
@@ -96,16 +73,8 @@ static bool rv32emu_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t fun
     *value_out = raw & 0xffu;
     return true;
   case 0x5: /* lhu */
-    if ((addr & 1u) == 0u) {
-      if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
-        return false;
-      }
-    } else {
-      if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-          !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1)) {
-        return false;
-      }
-      raw = (b0 & 0xffu) | ((b1 & 0xffu) << 8);
+    if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
+      return false;
     }
     *value_out = raw & 0xffffu;
     return true;
@@ -124,22 +93,10 @@ static bool rv32emu_store_value(rv32emu_machine_t *m, uint32_t addr, uint32_t fu
     ok = rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value);
     break;
   case 0x1: /* sh */
-    if ((addr & 1u) == 0u) {
-      ok = rv32emu_virt_write(m, addr, 2, RV32EMU_ACC_STORE, value);
-    } else {
-      ok = rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value & 0xffu) &&
-           rv32emu_virt_write(m, addr + 1u, 1, RV32EMU_ACC_STORE, (value >> 8) & 0xffu);
-    }
+    ok = rv32emu_virt_write(m, addr, 2, RV32EMU_ACC_STORE, value);
     break;
   case 0x2: /* sw */
-    if ((addr & 3u) == 0u) {
-      ok = rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, value);
-    } else {
-      ok = rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value & 0xffu) &&
-           rv32emu_virt_write(m, addr + 1u, 1, RV32EMU_ACC_STORE, (value >> 8) & 0xffu) &&
-           rv32emu_virt_write(m, addr + 2u, 1, RV32EMU_ACC_STORE, (value >> 16) & 0xffu) &&
-           rv32emu_virt_write(m, addr + 3u, 1, RV32EMU_ACC_STORE, (value >> 24) & 0xffu);
-    }
+    ok = rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, value);
     break;
   default:
     rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, 0);
@@ -147,7 +104,7 @@ static bool rv32emu_store_value(rv32emu_machine_t *m, uint32_t addr, uint32_t fu
   }
 
   if (ok) {
-    atomic_store_explicit(&RV32EMU_CPU(m)->lr_valid, false, memory_order_release);
+    rv32emu_lr_clear(m, RV32EMU_CPU(m));
   }
   return ok;
 }
@@ -344,6 +301,40 @@ static bool rv32emu_exec_muldiv(rv32emu_machine_t *m, uint32_t rd, uint32_t func
   return true;
 }
 
+static bool rv32emu_amo_decode(uint32_t funct5, rv32emu_amo_op_t *op_out) {
+  switch (funct5) {
+  case 0x01: /* amoswap.w */
+    *op_out = RV32EMU_AMO_SWAP;
+    return true;
+  case 0x00: /* amoadd.w */
+    *op_out = RV32EMU_AMO_ADD;
+    return true;
+  case 0x04: /* amoxor.w */
+    *op_out = RV32EMU_AMO_XOR;
+    return true;
+  case 0x0c: /* amoand.w */
+    *op_out = RV32EMU_AMO_AND;
+    return true;
+  case 0x08: /* amoor.w */
+    *op_out = RV32EMU_AMO_OR;
+    return true;
+  case 0x10: /* amomin.w */
+    *op_out = RV32EMU_AMO_MIN;
+    return true;
+  case 0x14: /* amomax.w */
+    *op_out = RV32EMU_AMO_MAX;
+    return true;
+  case 0x18: /* amominu.w */
+    *op_out = RV32EMU_AMO_MINU;
+    return true;
+  case 0x1c: /* amomaxu.w */
+    *op_out = RV32EMU_AMO_MAXU;
+    return true;
+  default:
+    return false;
+  }
+}
+
 static bool rv32emu_exec_amo(rv32emu_machine_t *m, uint32_t insn) {
   uint32_t rd = rv32emu_bits(insn, 11, 7);
   uint32_t rs1 = rv32emu_bits(insn, 19, 15);
@@ -352,11 +343,11 @@ static bool rv32emu_exec_amo(rv32emu_machine_t *m, uint32_t insn) {
   uint32_t funct5 = rv32emu_bits(insn, 31, 27);
   uint32_t addr = RV32EMU_CPU(m)->x[rs1];
   uint32_t old_val = 0;
-  uint32_t new_val = 0;
   uint32_t rs2v = RV32EMU_CPU(m)->x[rs2];
-  bool ok = false;
+  rv32emu_amo_op_t op = RV32EMU_AMO_SWAP;
 
-  if (funct3 != 0x2u) {
+  if (funct3 != 0x2u || (funct5 == 0x2u && rs2 != 0u) ||
+      (funct5 != 0x2u && funct5 != 0x3u && !rv32emu_amo_decode(funct5, &op))) {
     rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, insn);
     return false;
   }
@@ -364,113 +355,63 @@ static bool rv32emu_exec_amo(rv32emu_machine_t *m, uint32_t insn) {
     rv32emu_raise_exception(m, RV32EMU_EXC_LOAD_MISALIGNED, addr);
     return false;
   }
-  if (pthread_mutex_lock(&m->plat.amo_lock) != 0) {
-    return false;
-  }
 
   if (funct5 == 0x2u) { /* lr.w */
-    if (rs2 != 0u) {
-      rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, insn);
-      goto out;
-    }
     /*
      * lr.w:
      * - load the target word;
      * - create a reservation on that address for the current hart.
      *
-     * Reservation state is represented by (lr_valid, lr_addr). It may be
-     * invalidated later by any committed overlapping store from any hart
-     * (see rv32emu_virt_write() invalidation hook).
+     * Reservation state is represented by (lr_valid, lr_addr, lr_value). It
+     * may be invalidated later by any committed overlapping store from any
+     * hart (see rv32emu_virt_write() invalidation hook). The reservation is
+     * published before the load so a racing store cannot slip between them.
      */
+    rv32emu_lr_set(m, RV32EMU_CPU(m), addr);
     if (!rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, &old_val)) {
-      goto out;
+      rv32emu_lr_clear(m, RV32EMU_CPU(m));
+      return false;
     }
-    RV32EMU_CPU(m)->lr_addr = addr;
-    atomic_store_explicit(&RV32EMU_CPU(m)->lr_valid, true, memory_order_release);
+    RV32EMU_CPU(m)->lr_value = old_val;
     rv32emu_write_rd(m, rd, old_val);
-    ok = true;
-    goto out;
+    return true;
   }
 
   if (funct5 == 0x3u) { /* sc.w */
     uint32_t status = 1u;
+    bool swapped = false;
 
     /*
-     * sc.w succeeds only when the reservation is still valid and points to
-     * the same word address. On success:
-     * - perform the store;
-     * - write rd=0.
-     * On failure:
-     * - do not store;
-     * - write rd=1.
+     * sc.w succeeds only when the reservation is still valid, points to the
+     * same word address, and memory still holds the word lr.w observed. The
+     * last check and the store are one host CAS, which closes the window
+     * between the reservation check and a racing store from another hart.
+     * On success write rd=0, on failure leave memory alone and write rd=1.
      *
      * In both cases, sc.w consumes/clears the local reservation.
      */
     if (atomic_load_explicit(&RV32EMU_CPU(m)->lr_valid, memory_order_acquire) &&
         RV32EMU_CPU(m)->lr_addr == addr) {
-      if (!rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, rs2v)) {
-        goto out;
+      if (!rv32emu_virt_cas32(m, addr, RV32EMU_CPU(m)->lr_value, rs2v, &swapped)) {
+        return false;
       }
-      status = 0u;
+      status = swapped ? 0u : 1u;
     }
-    atomic_store_explicit(&RV32EMU_CPU(m)->lr_valid, false, memory_order_release);
+    rv32emu_lr_clear(m, RV32EMU_CPU(m));
     rv32emu_write_rd(m, rd, status);
-    ok = true;
-    goto out;
-  }
-
-  if (!rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, &old_val)) {
-    goto out;
-  }
-
-  switch (funct5) {
-  case 0x01: /* amoswap.w */
-    new_val = rs2v;
-    break;
-  case 0x00: /* amoadd.w */
-    new_val = old_val + rs2v;
-    break;
-  case 0x04: /* amoxor.w */
-    new_val = old_val ^ rs2v;
-    break;
-  case 0x0c: /* amoand.w */
-    new_val = old_val & rs2v;
-    break;
-  case 0x08: /* amoor.w */
-    new_val = old_val | rs2v;
-    break;
-  case 0x10: /* amomin.w */
-    new_val = ((int32_t)old_val < (int32_t)rs2v) ? old_val : rs2v;
-    break;
-  case 0x14: /* amomax.w */
-    new_val = ((int32_t)old_val > (int32_t)rs2v) ? old_val : rs2v;
-    break;
-  case 0x18: /* amominu.w */
-    new_val = (old_val < rs2v) ? old_val : rs2v;
-    break;
-  case 0x1c: /* amomaxu.w */
-    new_val = (old_val > rs2v) ? old_val : rs2v;
-    break;
-  default:
-    rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, insn);
-    goto out;
+    return true;
   }
 
-  if (!rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, new_val)) {
-    goto out;
+  if (!rv32emu_virt_amo32(m, addr, op, rs2v, &old_val)) {
+    return false;
   }
   /*
    * AMO writes are regular stores from LR/SC perspective, so clear local
-   * reservation as well. Cross-hart invalidation is handled by virt_write().
+   * reservation as well. Cross-hart invalidation is handled by virt_amo32().
    */
-  atomic_store_explicit(&RV32EMU_CPU(m)->lr_valid, false, memory_order_release);
+  rv32emu_lr_clear(m, RV32EMU_CPU(m));
   rv32emu_write_rd(m, rd, old_val);
-
-  ok = true;
-
-out:
-  (void)pthread_mutex_unlock(&m->plat.amo_lock);
-  return ok;
+  return true;
 }
 
 static bool rv32emu_exec_compressed(rv32emu_machine_t *m, uint16_t insn, uint32_t *next_pc) {
@@ -969,14 +910,20 @@ static bool rv32emu_exec_int_group(rv32emu_machine_t *m, const rv32emu_decoded_i
 
 /*
  * System/peripheral chapter:
- * - Fence (architectural no-op in this emulator)
+ * - fence is a no-op (host atomics already order memory); fence.i posts a
+ *   full TB flush to this hart's tb_fence
  * - AMO/FP dispatch
- * - SYSTEM: ecall/ebreak/mret/sret/wfi/sfence.vma + CSR path
+ * - SYSTEM: ecall/ebreak/mret/sret/wfi + CSR path; sfence.vma flushes the
+ *   TLB and walk cache here (just that page's entries when rs1 names one)
+ *   and posts the matching page, ASID or full TB flush
  */
 static bool rv32emu_exec_misc_group(rv32emu_machine_t *m, const rv32emu_decoded_insn_t *decoded,
                                     uint32_t rs1v, uint32_t *next_pc) {
   switch (decoded->opcode) {
   case 0x0f: /* fence/fence.i */
+    if (decoded->funct3 == 0x1u) {
+      rv32emu_fence_post(&RV32EMU_CPU(m)->tb_fence, RV32EMU_FENCE_ALL);
+    }
     return true;
   case 0x2f: /* amo */
     return rv32emu_exec_amo(m, decoded->raw);
@@ -1028,6 +975,9 @@ static bool rv32emu_exec_misc_group(rv32emu_machine_t *m, const rv32emu_decoded_
       return true;
     }
     if (decoded->raw == 0x10500073u) { /* wfi */
+      if (!rv32emu_hart_wfi_wakeup(RV32EMU_CPU(m))) {
+        RV32EMU_CPU(m)->wfi_idle = true; /* the runner parks the hart after retiring it */
+      }
       return true;
     }
     if ((decoded->raw & 0xfe007fffu) == 0x12000073u) { /* sfence.vma */
@@ -1035,6 +985,22 @@ static bool rv32emu_exec_misc_group(rv32emu_machine_t *m, const rv32emu_decoded_
         rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, decoded->raw);
         return false;
       }
+      /* The TLB is flushed here, so only tb_fence is posted and no irq_recheck is needed. */
+      if (decoded->rs1 != 0u) {
+        rv32emu_tlb_flush_page(m, RV32EMU_CPU(m), rs1v);
+        rv32emu_fence_post(&RV32EMU_CPU(m)->tb_fence, (rs1v & ~0xfffu) | RV32EMU_FENCE_PAGE);
+      } else if (decoded->rs2 != 0u) {
+        /* TB lines are tagged with satp, so only that ASID's lines go; the TLB is untagged. */
+        rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+        rv32emu_tlb_flush_walks(RV32EMU_CPU(m));
+        rv32emu_fence_post(&RV32EMU_CPU(m)->tb_fence,
+                           ((RV32EMU_CPU(m)->x[decoded->rs2] & 0x1ffu) << 12) |
+                               RV32EMU_FENCE_ASID);
+      } else {
+        rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+        rv32emu_tlb_flush_walks(RV32EMU_CPU(m));
+        rv32emu_fence_post(&RV32EMU_CPU(m)->tb_fence, RV32EMU_FENCE_ALL);
+      }
       return true;
     }
     rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, decoded->raw);
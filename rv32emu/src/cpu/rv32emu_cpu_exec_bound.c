@@ -0,0 +1,217 @@
+#include "rv32emu.h"
+#include "rv32emu_tb.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool rv32emu_exec_decoded(rv32emu_machine_t *m, const rv32emu_decoded_insn_t *decoded);
+
+/*
+ * Pre-bound handlers for TB lines:
+ * - rv32emu_exec_bind() resolves a decoded instruction to one handler for its
+ *   exact operation once, when the line is built;
+ * - rv32emu_exec_tb_block() then calls line->exec[i] directly, skipping the
+ *   opcode switch and the group-level funct3/funct7 switches;
+ * - every handler has the same effect as rv32emu_exec_decoded(): write rd,
+ *   keep x0 zero, advance pc, count the retire and tick the timer batch;
+ * - anything without a dedicated handler (M/A/F, CSR, system, malformed
+ *   encodings) binds to rv32emu_exec_bound_generic(), i.e. the full path.
+ */
+static inline bool rv32emu_bound_retire(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
+                                        uint32_t next_pc) {
+  cpu->pc = next_pc;
+  cpu->x[0] = 0u;
+  cpu->cycle += 1u;
+  cpu->instret += 1u;
+  cpu->timer_batch_ticks += 1u;
+  if (cpu->timer_batch_ticks >= cpu->timer_batch_limit) {
+    rv32emu_flush_timer(m);
+  }
+  return true;
+}
+
+static inline uint32_t rv32emu_bound_next_pc(const rv32emu_cpu_t *cpu,
+                                             const rv32emu_decoded_insn_t *d) {
+  return cpu->pc + ((d->insn_len == 2u) ? 2u : 4u);
+}
+
+static bool rv32emu_exec_bound_generic(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
+                                       const rv32emu_decoded_insn_t *d) {
+  (void)cpu;
+  return rv32emu_exec_decoded(m, d);
+}
+
+/* rd = expr over a = x[rs1], b = x[rs2], imm = imm_i */
+#define RV32EMU_BOUND_ALU(name, expr)                                                         \
+  static bool rv32emu_exec_bound_##name(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,           \
+                                        const rv32emu_decoded_insn_t *d) {                  \
+    uint32_t a = cpu->x[d->rs1];                                                            \
+    uint32_t b = cpu->x[d->rs2];                                                            \
+    uint32_t imm = (uint32_t)d->imm_i;                                                      \
+    (void)a;                                                                                \
+    (void)b;                                                                                \
+    (void)imm;                                                                              \
+    cpu->x[d->rd] = (expr);                                                                 \
+    return rv32emu_bound_retire(m, cpu, rv32emu_bound_next_pc(cpu, d));                     \
+  }
+
+RV32EMU_BOUND_ALU(addi, a + imm)
+RV32EMU_BOUND_ALU(slti, ((int32_t)a < (int32_t)imm) ? 1u : 0u)
+RV32EMU_BOUND_ALU(sltiu, (a < imm) ? 1u : 0u)
+RV32EMU_BOUND_ALU(xori, a ^ imm)
+RV32EMU_BOUND_ALU(ori, a | imm)
+RV32EMU_BOUND_ALU(andi, a & imm)
+RV32EMU_BOUND_ALU(slli, a << d->rs2)
+RV32EMU_BOUND_ALU(srli, a >> d->rs2)
+RV32EMU_BOUND_ALU(srai, (uint32_t)((int32_t)a >> d->rs2))
+RV32EMU_BOUND_ALU(add, a + b)
+RV32EMU_BOUND_ALU(sub, a - b)
+RV32EMU_BOUND_ALU(sll, a << (b & 0x1fu))
+RV32EMU_BOUND_ALU(slt, ((int32_t)a < (int32_t)b) ? 1u : 0u)
+RV32EMU_BOUND_ALU(sltu, (a < b) ? 1u : 0u)
+RV32EMU_BOUND_ALU(xor, a ^ b)
+RV32EMU_BOUND_ALU(srl, a >> (b & 0x1fu))
+RV32EMU_BOUND_ALU(sra, (uint32_t)((int32_t)a >> (b & 0x1fu)))
+RV32EMU_BOUND_ALU(or, a | b)
+RV32EMU_BOUND_ALU(and, a & b)
+RV32EMU_BOUND_ALU(lui, (uint32_t)d->imm_u)
+RV32EMU_BOUND_ALU(auipc, cpu->pc + (uint32_t)d->imm_u)
+
+#define RV32EMU_BOUND_BRANCH(name, cond)                                                      \
+  static bool rv32emu_exec_bound_##name(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,           \
+                                        const rv32emu_decoded_insn_t *d) {                  \
+    uint32_t a = cpu->x[d->rs1];                                                            \
+    uint32_t b = cpu->x[d->rs2];                                                            \
+    return rv32emu_bound_retire(m, cpu,                                                     \
+                                (cond) ? cpu->pc + (uint32_t)d->imm_b                       \
+                                       : rv32emu_bound_next_pc(cpu, d));                    \
+  }
+
+RV32EMU_BOUND_BRANCH(beq, a == b)
+RV32EMU_BOUND_BRANCH(bne, a != b)
+RV32EMU_BOUND_BRANCH(blt, (int32_t)a < (int32_t)b)
+RV32EMU_BOUND_BRANCH(bge, (int32_t)a >= (int32_t)b)
+RV32EMU_BOUND_BRANCH(bltu, a < b)
+RV32EMU_BOUND_BRANCH(bgeu, a >= b)
+
+static bool rv32emu_exec_bound_jal(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
+                                   const rv32emu_decoded_insn_t *d) {
+  uint32_t target = cpu->pc + (uint32_t)d->imm_j;
+
+  cpu->x[d->rd] = rv32emu_bound_next_pc(cpu, d);
+  return rv32emu_bound_retire(m, cpu, target);
+}
+
+static bool rv32emu_exec_bound_jalr(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
+                                    const rv32emu_decoded_insn_t *d) {
+  uint32_t target = (cpu->x[d->rs1] + (uint32_t)d->imm_i) & ~1u;
+
+  cpu->x[d->rd] = rv32emu_bound_next_pc(cpu, d);
+  return rv32emu_bound_retire(m, cpu, target);
+}
+
+/* rd = convert(raw) for a size-byte load from x[rs1] + imm_i */
+#define RV32EMU_BOUND_LOAD(name, size, convert)                                               \
+  static bool rv32emu_exec_bound_##name(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,           \
+                                        const rv32emu_decoded_insn_t *d) {                  \
+    uint32_t raw = 0u;                                                                      \
+                                                                                            \
+    if (!rv32emu_virt_read(m, cpu->x[d->rs1] + (uint32_t)d->imm_i, size, RV32EMU_ACC_LOAD,  \
+                           &raw)) {                                                         \
+      return false;                                                                         \
+    }                                                                                       \
+    cpu->x[d->rd] = (convert);                                                              \
+    return rv32emu_bound_retire(m, cpu, rv32emu_bound_next_pc(cpu, d));                     \
+  }
+
+RV32EMU_BOUND_LOAD(lb, 1, rv32emu_sign_extend(raw & 0xffu, 8))
+RV32EMU_BOUND_LOAD(lh, 2, rv32emu_sign_extend(raw & 0xffffu, 16))
+RV32EMU_BOUND_LOAD(lw, 4, raw)
+RV32EMU_BOUND_LOAD(lbu, 1, raw & 0xffu)
+RV32EMU_BOUND_LOAD(lhu, 2, raw & 0xffffu)
+
+#define RV32EMU_BOUND_STORE(name, size)                                                       \
+  static bool rv32emu_exec_bound_##name(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,           \
+                                        const rv32emu_decoded_insn_t *d) {                  \
+    if (!rv32emu_virt_write(m, cpu->x[d->rs1] + (uint32_t)d->imm_s, size,                  \
+                            RV32EMU_ACC_STORE, cpu->x[d->rs2])) {                           \
+      return false;                                                                         \
+    }                                                                                       \
+    rv32emu_lr_clear(m, cpu);                                                               \
+    return rv32emu_bound_retire(m, cpu, rv32emu_bound_next_pc(cpu, d));                     \
+  }
+
+RV32EMU_BOUND_STORE(sb, 1)
+RV32EMU_BOUND_STORE(sh, 2)
+RV32EMU_BOUND_STORE(sw, 4)
+
+rv32emu_tb_exec_fn_t rv32emu_exec_bind(const rv32emu_decoded_insn_t *d) {
+  static const rv32emu_tb_exec_fn_t op_imm[8] = {
+      rv32emu_exec_bound_addi, NULL, rv32emu_exec_bound_slti, rv32emu_exec_bound_sltiu,
+      rv32emu_exec_bound_xori, NULL, rv32emu_exec_bound_ori,  rv32emu_exec_bound_andi,
+  };
+  static const rv32emu_tb_exec_fn_t op[8] = {
+      NULL, rv32emu_exec_bound_sll, rv32emu_exec_bound_slt, rv32emu_exec_bound_sltu,
+      rv32emu_exec_bound_xor, NULL, rv32emu_exec_bound_or, rv32emu_exec_bound_and,
+  };
+  static const rv32emu_tb_exec_fn_t branch[8] = {
+      rv32emu_exec_bound_beq, rv32emu_exec_bound_bne,  NULL, NULL,
+      rv32emu_exec_bound_blt, rv32emu_exec_bound_bge, rv32emu_exec_bound_bltu,
+      rv32emu_exec_bound_bgeu,
+  };
+  static const rv32emu_tb_exec_fn_t load[8] = {
+      rv32emu_exec_bound_lb,  rv32emu_exec_bound_lh, rv32emu_exec_bound_lw, NULL,
+      rv32emu_exec_bound_lbu, rv32emu_exec_bound_lhu, NULL, NULL,
+  };
+  static const rv32emu_tb_exec_fn_t store[8] = {
+      rv32emu_exec_bound_sb, rv32emu_exec_bound_sh, rv32emu_exec_bound_sw, NULL,
+      NULL, NULL, NULL, NULL,
+  };
+  rv32emu_tb_exec_fn_t fn = NULL;
+  uint32_t f3 = d->funct3 & 0x7u;
+
+  switch (d->opcode) {
+  case 0x13: /* op-imm */
+    if (f3 == 0x1u) {
+      fn = d->funct7 == 0x00u ? rv32emu_exec_bound_slli : NULL;
+    } else if (f3 == 0x5u) {
+      fn = d->funct7 == 0x00u   ? rv32emu_exec_bound_srli
+           : d->funct7 == 0x20u ? rv32emu_exec_bound_srai
+                                : NULL;
+    } else {
+      fn = op_imm[f3];
+    }
+    break;
+  case 0x33: /* op; M extension stays on the generic path */
+    if (d->funct7 == 0x00u) {
+      fn = f3 == 0x0u ? rv32emu_exec_bound_add : f3 == 0x5u ? rv32emu_exec_bound_srl : op[f3];
+    } else if (d->funct7 == 0x20u) {
+      fn = f3 == 0x0u ? rv32emu_exec_bound_sub : f3 == 0x5u ? rv32emu_exec_bound_sra : NULL;
+    }
+    break;
+  case 0x37:
+    fn = rv32emu_exec_bound_lui;
+    break;
+  case 0x17:
+    fn = rv32emu_exec_bound_auipc;
+    break;
+  case 0x6f:
+    fn = rv32emu_exec_bound_jal;
+    break;
+  case 0x67:
+    fn = f3 == 0x0u ? rv32emu_exec_bound_jalr : NULL;
+    break;
+  case 0x63:
+    fn = branch[f3];
+    break;
+  case 0x03:
+    fn = load[f3];
+    break;
+  case 0x23:
+    fn = store[f3];
+    break;
+  default:
+    break;
+  }
+  return fn != NULL ? fn : rv32emu_exec_bound_generic;
+}
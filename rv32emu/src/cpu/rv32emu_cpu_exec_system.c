@@ -120,13 +120,18 @@ bool rv32emu_exec_mret(rv32emu_machine_t *m, uint32_t *next_pc) {
   mstatus &= ~MSTATUS_MPP_MASK;
 
   RV32EMU_CPU(m)->csr[CSR_MSTATUS] = mstatus;
-  RV32EMU_CPU(m)->priv = (rv32emu_priv_t)(mpp & 0x3u);
+  rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
+  if (RV32EMU_CPU(m)->priv != (rv32emu_priv_t)(mpp & 0x3u)) {
+    RV32EMU_CPU(m)->priv = (rv32emu_priv_t)(mpp & 0x3u);
+    rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+  }
   *next_pc = RV32EMU_CPU(m)->csr[CSR_MEPC] & ~1u;
   return true;
 }
 
 bool rv32emu_exec_sret(rv32emu_machine_t *m, uint32_t *next_pc) {
   uint32_t mstatus;
+  rv32emu_priv_t prev_priv = RV32EMU_CPU(m)->priv;
 
   if (RV32EMU_CPU(m)->priv == RV32EMU_PRIV_U) {
     return false;
@@ -148,6 +153,10 @@ bool rv32emu_exec_sret(rv32emu_machine_t *m, uint32_t *next_pc) {
   mstatus &= ~MSTATUS_SPP;
 
   RV32EMU_CPU(m)->csr[CSR_MSTATUS] = mstatus;
+  rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
+  if (RV32EMU_CPU(m)->priv != prev_priv) {
+    rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+  }
   *next_pc = RV32EMU_CPU(m)->csr[CSR_SEPC] & ~1u;
   return true;
 }
@@ -95,6 +95,7 @@ static int rv32emu_run_single_thread(rv32emu_machine_t *m, uint64_t max_instruct
 
   while (executed < max_instructions) {
     bool progressed = false;
+    bool idle = false;
     uint32_t checked;
 
     for (checked = 0u; checked < m->hart_count; checked++) {
@@ -103,12 +104,20 @@ static int rv32emu_run_single_thread(rv32emu_machine_t *m, uint64_t max_instruct
       if (!atomic_load_explicit(&m->harts[hart].running, memory_order_acquire)) {
         continue;
       }
+      if (m->harts[hart].wfi_idle) {
+        if (!rv32emu_hart_wfi_wakeup(&m->harts[hart])) {
+          idle = true;
+          continue;
+        }
+        m->harts[hart].wfi_idle = false;
+      }
 
       progressed = true;
       rv32emu_set_active_hart(m, hart);
 
       for (uint32_t slice = 0u;
            slice < RV32EMU_HART_SLICE_INSTR && executed < max_instructions &&
+           !RV32EMU_CPU(m)->wfi_idle &&
            atomic_load_explicit(&RV32EMU_CPU(m)->running, memory_order_acquire);) {
         uint32_t steps = 0u;
         bool jit_handled = false;
@@ -212,11 +221,15 @@ static int rv32emu_run_single_thread(rv32emu_machine_t *m, uint64_t max_instruct
         slice += 1u;
       }
 
+      rv32emu_flush_timer(m); /* slice boundary: publish this hart's batched mtime */
       next_hart = (hart + 1u) % m->hart_count;
       break;
     }
 
     if (!progressed) {
+      if (idle && rv32emu_harts_idle_wait(m)) {
+        continue;
+      }
       break;
     }
   }
@@ -259,6 +272,18 @@ static bool rv32emu_worker_commit_executed(rv32emu_thread_state_t *state, uint64
   return false;
 }
 
+static bool rv32emu_other_harts_parked(const rv32emu_machine_t *m, const rv32emu_cpu_t *self) {
+  for (uint32_t hart = 0u; hart < m->hart_count; hart++) {
+    const rv32emu_cpu_t *cpu = &m->harts[hart];
+
+    if (cpu != self && atomic_load_explicit(&cpu->running, memory_order_acquire) &&
+        !atomic_load_explicit(&cpu->wfi_parked, memory_order_relaxed)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static void *rv32emu_run_worker(void *opaque) {
   rv32emu_worker_ctx_t *ctx = (rv32emu_worker_ctx_t *)opaque;
   rv32emu_thread_state_t *state = ctx->state;
@@ -293,6 +318,25 @@ static void *rv32emu_run_worker(void *opaque) {
         continue;
       }
     }
+    if (cpu->wfi_idle) {
+      (void)rv32emu_worker_commit_executed(state, &local_executed, ctx->max_instructions);
+      rv32emu_flush_timer(ctx->m);
+      if (ctx->m->opts.mtime_source == RV32EMU_MTIME_INSTRET &&
+          rv32emu_other_harts_parked(ctx->m, cpu)) {
+        /* Last hart to go idle: jump time ahead, or keep spinning if no deadline is ahead. */
+        if (!rv32emu_timer_fast_forward(ctx->m) || rv32emu_hart_wfi_wakeup(cpu)) {
+          cpu->wfi_idle = false;
+          continue;
+        }
+      }
+      if (!rv32emu_hart_park(ctx->m, cpu) &&
+          ctx->m->opts.mtime_source == RV32EMU_MTIME_HOST &&
+          rv32emu_other_harts_parked(ctx->m, cpu)) {
+        /* Whole machine idle: return so the caller can feed input; the rest time out. */
+        atomic_store_explicit(&state->stop, true, memory_order_release);
+      }
+      continue;
+    }
     if (rv32emu_check_pending_interrupt(ctx->m)) {
       if (!atomic_load_explicit(&cpu->running, memory_order_acquire) &&
           !rv32emu_any_hart_running(ctx->m)) {
@@ -388,6 +432,7 @@ static void *rv32emu_run_worker(void *opaque) {
   (void)rv32emu_worker_commit_executed(state, &local_executed, ctx->max_instructions);
   rv32emu_flush_timer(ctx->m);
   rv32emu_unbind_thread_hart();
+  atomic_store_explicit(&cpu->worker_bound, false, memory_order_release);
   return NULL;
 }
 
@@ -403,6 +448,12 @@ static int rv32emu_run_threaded(rv32emu_machine_t *m, uint64_t max_instructions,
 
   atomic_store_explicit(&state.executed, 0u, memory_order_relaxed);
   atomic_store_explicit(&state.stop, false, memory_order_relaxed);
+  /*
+   * DRAM access mode switch: plain host loads/stores are only used while a
+   * single host thread runs guest code. The flag flips before any worker is
+   * created and back only after every worker is joined, so pthread_create/
+   * pthread_join order all plain accesses against the atomic ones.
+   */
   m->threaded_exec_active = true;
   for (hart = 0u; hart < m->hart_count; hart++) {
     m->harts[hart].timer_batch_ticks = 0u;
@@ -418,7 +469,10 @@ static int rv32emu_run_threaded(rv32emu_machine_t *m, uint64_t max_instructions,
     workers[hart].jit_skip_mmode = jit_skip_mmode;
     workers[hart].jit_guard = jit_guard;
 
+    /* Set before the worker exists so SBI rfence never flushes its TLB from outside. */
+    atomic_store_explicit(&m->harts[hart].worker_bound, true, memory_order_release);
     if (pthread_create(&threads[hart], NULL, rv32emu_run_worker, &workers[hart]) != 0) {
+      atomic_store_explicit(&m->harts[hart].worker_bound, false, memory_order_release);
       create_failed = true;
       break;
     }
@@ -468,6 +522,10 @@ int rv32emu_run(rv32emu_machine_t *m, uint64_t max_instructions) {
   if (max_instructions == 0) {
     max_instructions = RV32EMU_DEFAULT_MAX_INSTR;
   }
+  /* Hart state may have been set directly since the last run. */
+  for (uint32_t hart = 0u; hart < m->hart_count; hart++) {
+    rv32emu_cpu_irq_recheck(&m->harts[hart]);
+  }
   use_tb = rv32emu_env_bool("RV32EMU_EXPERIMENTAL_TB", false);
   use_jit = rv32emu_env_bool("RV32EMU_EXPERIMENTAL_JIT", false);
   /*
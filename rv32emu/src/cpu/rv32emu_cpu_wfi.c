@@ -0,0 +1,145 @@
+#include "rv32emu.h"
+
+#include <errno.h>
+#include <time.h>
+
+/*
+ * WFI parking:
+ * - wfi sets cpu->wfi_idle when no enabled interrupt is pending;
+ * - threaded runs block the worker in rv32emu_hart_park() until mip gains an
+ *   enabled bit (rv32emu_cpu_mip_set_bits wakes parked harts), the hart is
+ *   stopped, or the next timer deadline passes;
+ * - single-thread runs skip idle harts and call rv32emu_harts_idle_wait()
+ *   once every running hart is idle.
+ * Host-clock waits are clamped to RV32EMU_WFI_PARK_MAX_NS so the caller of
+ * rv32emu_run (stdin pump, instruction budget) regains control. Instret
+ * time only moves while harts retire, so the last hart to go idle jumps
+ * mtime to the next deadline instead (rv32emu_timer_fast_forward).
+ */
+bool rv32emu_hart_park_init(rv32emu_machine_t *m) {
+  pthread_condattr_t attr;
+  uint32_t hart;
+
+  if (pthread_condattr_init(&attr) != 0) {
+    return false;
+  }
+  (void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  for (hart = 0u; hart < RV32EMU_MAX_HARTS; hart++) {
+    rv32emu_cpu_t *cpu = &m->harts[hart];
+
+    if (pthread_mutex_init(&cpu->park_lock, NULL) != 0) {
+      break;
+    }
+    if (pthread_cond_init(&cpu->park_cond, &attr) != 0) {
+      (void)pthread_mutex_destroy(&cpu->park_lock);
+      break;
+    }
+  }
+  (void)pthread_condattr_destroy(&attr);
+  if (hart != RV32EMU_MAX_HARTS) {
+    while (hart-- > 0u) {
+      (void)pthread_cond_destroy(&m->harts[hart].park_cond);
+      (void)pthread_mutex_destroy(&m->harts[hart].park_lock);
+    }
+    return false;
+  }
+  m->plat.park_ready = true;
+  return true;
+}
+
+void rv32emu_hart_park_destroy(rv32emu_machine_t *m) {
+  if (m == NULL || !m->plat.park_ready) {
+    return;
+  }
+  for (uint32_t hart = 0u; hart < RV32EMU_MAX_HARTS; hart++) {
+    (void)pthread_cond_destroy(&m->harts[hart].park_cond);
+    (void)pthread_mutex_destroy(&m->harts[hart].park_lock);
+  }
+  m->plat.park_ready = false;
+}
+
+/*
+ * WFI resumes on any pending interrupt enabled in mie, whatever mstatus says.
+ * The mip load is seq_cst, not rv32emu_cpu_mip_load(): it is the second half
+ * of the wfi_parked store in rv32emu_hart_park() and must not be ordered
+ * before it against the fetch_or/wfi_parked load in rv32emu_cpu_mip_set_bits().
+ */
+bool rv32emu_hart_wfi_wakeup(const rv32emu_cpu_t *cpu) {
+  return (atomic_load_explicit(&cpu->mip, memory_order_seq_cst) & cpu->csr[CSR_MIE]) != 0u ||
+         !atomic_load_explicit(&cpu->running, memory_order_acquire);
+}
+
+void rv32emu_hart_wake(rv32emu_cpu_t *cpu) {
+  (void)pthread_mutex_lock(&cpu->park_lock);
+  (void)pthread_cond_signal(&cpu->park_cond);
+  (void)pthread_mutex_unlock(&cpu->park_lock);
+}
+
+static void rv32emu_deadline_after(struct timespec *ts, uint64_t ns) {
+  (void)clock_gettime(CLOCK_MONOTONIC, ts);
+  ts->tv_sec += (time_t)(ns / 1000000000u);
+  ts->tv_nsec += (long)(ns % 1000000000u);
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+/*
+ * Block the calling worker until cpu has something to do; wfi_idle stays
+ * set if it still has not. Returns false if the wait ran into
+ * RV32EMU_WFI_PARK_MAX_NS with the hart still idle.
+ */
+bool rv32emu_hart_park(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
+  struct timespec until;
+  uint64_t ns;
+  int rc = 0;
+
+  ns = rv32emu_timer_idle_ns(m, RV32EMU_WFI_PARK_MAX_NS);
+  rv32emu_deadline_after(&until, ns);
+  (void)pthread_mutex_lock(&cpu->park_lock);
+  atomic_store_explicit(&cpu->wfi_parked, true, memory_order_seq_cst);
+  while (!rv32emu_hart_wfi_wakeup(cpu) && rc != ETIMEDOUT) {
+    rc = pthread_cond_timedwait(&cpu->park_cond, &cpu->park_lock, &until);
+  }
+  atomic_store_explicit(&cpu->wfi_parked, false, memory_order_relaxed);
+  (void)pthread_mutex_unlock(&cpu->park_lock);
+  rv32emu_flush_timer(m); /* publish host time; raises the timer interrupt if due */
+  cpu->wfi_idle = !rv32emu_hart_wfi_wakeup(cpu);
+  return rc != ETIMEDOUT || ns != RV32EMU_WFI_PARK_MAX_NS || !cpu->wfi_idle;
+}
+
+/*
+ * Single-thread runner with every running hart idle. Instret time jumps to
+ * the next deadline; with none ahead the harts resume spinning as plain
+ * wfi no-ops. Host time sleeps until the deadline. Returns false if the
+ * sleep was clamped, so the run loop hands control back to its caller.
+ */
+bool rv32emu_harts_idle_wait(rv32emu_machine_t *m) {
+  uint64_t ns;
+  struct timespec ts;
+
+  if (m->opts.mtime_source == RV32EMU_MTIME_INSTRET) {
+    if (!rv32emu_timer_fast_forward(m)) {
+      for (uint32_t hart = 0u; hart < m->hart_count; hart++) {
+        m->harts[hart].wfi_idle = false;
+      }
+    }
+    return true;
+  }
+
+  ns = rv32emu_timer_idle_ns(m, RV32EMU_WFI_PARK_MAX_NS);
+  ts.tv_sec = (time_t)(ns / 1000000000u);
+  ts.tv_nsec = (long)(ns % 1000000000u);
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+  rv32emu_flush_timer(m);
+  for (uint32_t hart = 0u; hart < m->hart_count; hart++) {
+    rv32emu_cpu_t *cpu = &m->harts[hart];
+
+    if (cpu->wfi_idle && rv32emu_hart_wfi_wakeup(cpu)) {
+      return true;
+    }
+  }
+  return ns != RV32EMU_WFI_PARK_MAX_NS;
+}
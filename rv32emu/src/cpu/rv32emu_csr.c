@@ -70,12 +70,14 @@ uint32_t rv32emu_csr_read(rv32emu_machine_t *m, uint16_t csr_num) {
   case CSR_CYCLE:
     return (uint32_t)RV32EMU_CPU(m)->cycle;
   case CSR_TIME:
+    rv32emu_flush_timer(m);
     return (uint32_t)atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
   case CSR_INSTRET:
     return (uint32_t)RV32EMU_CPU(m)->instret;
   case CSR_CYCLEH:
     return (uint32_t)(RV32EMU_CPU(m)->cycle >> 32);
   case CSR_TIMEH:
+    rv32emu_flush_timer(m);
     return (uint32_t)(atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >> 32);
   case CSR_INSTRETH:
     return (uint32_t)(RV32EMU_CPU(m)->instret >> 32);
@@ -90,6 +92,21 @@ uint32_t rv32emu_csr_read(rv32emu_machine_t *m, uint16_t csr_num) {
   return RV32EMU_CPU(m)->csr[csr_num];
 }
 
+/*
+ * Cached TLB permissions depend on SUM/MXR and, for M-mode data accesses, on
+ * MPRV/MPP. Guests toggle SIE (local_irq_save/restore) far more often than
+ * any of those, so only a change to one of them flushes the TLB.
+ */
+static void rv32emu_csr_write_mstatus(rv32emu_machine_t *m, uint32_t value) {
+  uint32_t changed = RV32EMU_CPU(m)->csr[CSR_MSTATUS] ^ value;
+
+  RV32EMU_CPU(m)->csr[CSR_MSTATUS] = value;
+  if ((changed & (MSTATUS_SUM | MSTATUS_MXR | MSTATUS_MPRV | MSTATUS_MPP_MASK)) != 0u) {
+    rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+  }
+  rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
+}
+
 void rv32emu_csr_write(rv32emu_machine_t *m, uint16_t csr_num, uint32_t value) {
   if (m == NULL || csr_num >= 4096) {
     return;
@@ -106,11 +123,27 @@ void rv32emu_csr_write(rv32emu_machine_t *m, uint16_t csr_num, uint32_t value) {
     RV32EMU_CPU(m)->csr[CSR_FCSR] = value & 0xffu;
     return;
   case CSR_SSTATUS:
-    RV32EMU_CPU(m)->csr[CSR_MSTATUS] =
-        (RV32EMU_CPU(m)->csr[CSR_MSTATUS] & ~SSTATUS_MASK) | (value & SSTATUS_MASK);
+    rv32emu_csr_write_mstatus(m, (RV32EMU_CPU(m)->csr[CSR_MSTATUS] & ~SSTATUS_MASK) |
+                                     (value & SSTATUS_MASK));
+    return;
+  case CSR_MSTATUS:
+    rv32emu_csr_write_mstatus(m, value);
+    return;
+  case CSR_SATP:
+    /* The root feeds the cached translation context. */
+    rv32emu_tlb_flush_walks(RV32EMU_CPU(m));
+    RV32EMU_CPU(m)->csr[csr_num] = value;
+    rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+    rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
     return;
   case CSR_SIE:
     RV32EMU_CPU(m)->csr[CSR_MIE] = (RV32EMU_CPU(m)->csr[CSR_MIE] & ~SIE_MASK) | (value & SIE_MASK);
+    rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
+    return;
+  case CSR_MIE:
+  case CSR_MIDELEG:
+    RV32EMU_CPU(m)->csr[csr_num] = value;
+    rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
     return;
   case CSR_SIP:
     rv32emu_cpu_mip_store(RV32EMU_CPU(m),
@@ -4,6 +4,8 @@
 
 #define SATP_MODE_SV32 (1u << 31)
 #define SATP_PPN_MASK 0x003fffffu
+#define TLB_CTX_SUM (1u << 2)
+#define TLB_CTX_MXR (1u << 3)
 
 /*
  * Reservation invalidation needs range overlap checks because stores may be
@@ -30,7 +32,9 @@ static bool rv32emu_ranges_overlap(uint32_t addr_a, uint32_t len_a, uint32_t add
  * reservation, so a later sc.w must fail.
  *
  * We track one reservation per hart (lr_addr/lr_valid) and clear all
- * overlapping reservations after every committed store.
+ * overlapping reservations after every committed store. plat.lr_live counts
+ * live reservations, so with none outstanding a store pays one load here
+ * instead of a scan over every hart (plus a fence while worker threads run).
  */
 static void rv32emu_invalidate_lr_reservations(rv32emu_machine_t *m, uint32_t vaddr, int len) {
   uint32_t hartid;
@@ -38,6 +42,18 @@ static void rv32emu_invalidate_lr_reservations(rv32emu_machine_t *m, uint32_t va
   if (m == NULL || len <= 0) {
     return;
   }
+  /*
+   * Store/load pair against rv32emu_lr_set(): the committed store above and
+   * the seq_cst count increment there must not pass each other, otherwise a
+   * racing lr.w could load the old word while this hart sees no reservation.
+   * Only worker threads can race; a single-thread run is ordered already.
+   */
+  if (m->threaded_exec_active) {
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+  if (atomic_load_explicit(&m->plat.lr_live, memory_order_relaxed) == 0u) {
+    return;
+  }
 
   for (hartid = 0u; hartid < m->hart_count; hartid++) {
     rv32emu_cpu_t *cpu = rv32emu_hart_cpu(m, hartid);
@@ -46,9 +62,187 @@ static void rv32emu_invalidate_lr_reservations(rv32emu_machine_t *m, uint32_t va
       continue;
     }
     if (rv32emu_ranges_overlap(vaddr, (uint32_t)len, cpu->lr_addr, 4u)) {
-      atomic_store_explicit(&cpu->lr_valid, false, memory_order_release);
+      rv32emu_lr_clear(m, cpu);
+    }
+  }
+}
+
+static void rv32emu_tlb_stat_inc(rv32emu_machine_t *m, atomic_uint_fast64_t *counter) {
+  if (!m->plat.dram_atomic_stats_enable) {
+    return;
+  }
+  atomic_fetch_add_explicit(counter, 1u, memory_order_relaxed);
+}
+
+/*
+ * Software TLB: one direct-mapped ITLB and DTLB per hart, indexed by VPN.
+ * Megapage (level-1) leaves go to a small fully associative MTLB shared by
+ * fetches and data accesses instead, so a kernel linear map costs a handful
+ * of entries and never evicts 4 KiB user translations.
+ * A page-walk cache (cpu->pwc) remembers level-1 pointers so a 4 KiB miss
+ * reads only the leaf PTE. It does not depend on privilege or SUM/MXR, so
+ * only sfence.vma and satp writes drop it, not the TLB flushes on traps.
+ * Entries are only ever touched by the owning hart, so no locking is needed.
+ * The tag covers satp plus the translation context (effective privilege and
+ * SUM/MXR), and flushes happen on sfence.vma, satp/mstatus writes and traps
+ * that change privilege.
+ */
+void rv32emu_tlb_flush(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
+  uint32_t entries;
+
+  if (m == NULL || cpu == NULL) {
+    return;
+  }
+
+  entries = m->opts.tlb_entries;
+  for (uint32_t i = 0u; i < entries; i++) {
+    cpu->itlb[i].valid = false;
+    cpu->dtlb[i].valid = false;
+  }
+  for (uint32_t i = 0u; i < RV32EMU_MTLB_ENTRIES; i++) {
+    cpu->mtlb[i].valid = false;
+  }
+}
+
+void rv32emu_tlb_flush_page(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_t vaddr) {
+  uint32_t vpn = vaddr >> 12;
+  uint32_t index;
+
+  if (m == NULL || cpu == NULL || m->opts.tlb_entries == 0u) {
+    return;
+  }
+
+  index = vpn & (m->opts.tlb_entries - 1u);
+  if (cpu->itlb[index].vpn == vpn) {
+    cpu->itlb[index].valid = false;
+  }
+  if (cpu->dtlb[index].vpn == vpn) {
+    cpu->dtlb[index].valid = false;
+  }
+  for (uint32_t i = 0u; i < RV32EMU_MTLB_ENTRIES; i++) {
+    if (cpu->mtlb[i].vpn == (vaddr >> 22)) {
+      cpu->mtlb[i].valid = false;
     }
   }
+  /* Linux frees page tables with ranged fences, so the page's pointer goes too. */
+  if (cpu->pwc[(vaddr >> 22) & (RV32EMU_PWC_ENTRIES - 1u)].vpn1 == (vaddr >> 22)) {
+    cpu->pwc[(vaddr >> 22) & (RV32EMU_PWC_ENTRIES - 1u)].valid = false;
+  }
+}
+
+void rv32emu_tlb_flush_walks(rv32emu_cpu_t *cpu) {
+  if (cpu == NULL) {
+    return;
+  }
+  for (uint32_t i = 0u; i < RV32EMU_PWC_ENTRIES; i++) {
+    cpu->pwc[i].valid = false;
+  }
+}
+
+static rv32emu_tlb_entry_t *rv32emu_mtlb_find(rv32emu_cpu_t *cpu, uint32_t vaddr, uint32_t satp,
+                                              uint8_t ctx) {
+  for (uint32_t i = 0u; i < RV32EMU_MTLB_ENTRIES; i++) {
+    rv32emu_tlb_entry_t *entry = &cpu->mtlb[i];
+
+    if (entry->valid && entry->vpn == (vaddr >> 22) && entry->satp == satp && entry->ctx == ctx) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* Refill the slot already holding this megapage (e.g. after a D update), else round-robin. */
+static void rv32emu_mtlb_fill(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_t vaddr,
+                              uint32_t paddr, uint32_t satp, uint8_t ctx, uint8_t perm) {
+  rv32emu_tlb_entry_t *entry = rv32emu_mtlb_find(cpu, vaddr, satp, ctx);
+
+  if (entry == NULL) {
+    entry = &cpu->mtlb[cpu->mtlb_next++ & (RV32EMU_MTLB_ENTRIES - 1u)];
+  }
+  entry->vpn = vaddr >> 22;
+  entry->ppn = paddr >> 22;
+  entry->satp = satp;
+  entry->ctx = ctx;
+  entry->perm = perm;
+  entry->host_page = rv32emu_dram_ptr(m, paddr & ~0x3fffffu, 1u << 22);
+  entry->valid = perm != 0u;
+}
+
+/*
+ * Fence requests are posted into a per-hart word and consumed by the owner:
+ * the TLB side in rv32emu_scan_pending_interrupt(), which only runs while
+ * irq_check is set, the TB side by the TB dispatcher. Whoever posts a TLB
+ * fence must therefore call rv32emu_cpu_irq_recheck() on the target after it,
+ * or the fence sits unapplied until some unrelated interrupt change. A word
+ * holds one page; a second distinct page widens it to RV32EMU_FENCE_ALL, so
+ * merging never loses a flush.
+ */
+void rv32emu_fence_post(atomic_uint *slot, uint32_t req) {
+  unsigned int cur = atomic_load_explicit(slot, memory_order_relaxed);
+  unsigned int want;
+
+  do {
+    if (cur == RV32EMU_FENCE_ALL || cur == req) {
+      return;
+    }
+    want = (cur == 0u) ? req : RV32EMU_FENCE_ALL;
+  } while (!atomic_compare_exchange_weak_explicit(slot, &cur, want, memory_order_release,
+                                                  memory_order_relaxed));
+}
+
+/*
+ * Apply the posted TLB fence, then publish fence_ack: every SBI rfence
+ * that bumped fence_seq before the load below has been applied once the
+ * store is visible. Called by the owner, or by an SBI rfence caller while
+ * the owner cannot run (parked under park_lock, or no worker threads).
+ */
+void rv32emu_tlb_sync_fence(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
+  unsigned int seq = atomic_load_explicit(&cpu->fence_seq, memory_order_acquire);
+  uint32_t req;
+
+  if (atomic_load_explicit(&cpu->tlb_fence, memory_order_relaxed) != 0u) {
+    req = atomic_exchange_explicit(&cpu->tlb_fence, 0u, memory_order_acquire);
+    if (req == RV32EMU_FENCE_ALL) {
+      rv32emu_tlb_flush(m, cpu);
+      rv32emu_tlb_flush_walks(cpu);
+    } else if (req != 0u) {
+      rv32emu_tlb_flush_page(m, cpu, req);
+    }
+  }
+  if (atomic_load_explicit(&cpu->fence_ack, memory_order_relaxed) != seq) {
+    atomic_store_explicit(&cpu->fence_ack, seq, memory_order_release);
+  }
+}
+
+/*
+ * Precompute every access kind a leaf PTE allows in the given context, so a
+ * later hit only has to test one bit. Stores additionally require D=1: a
+ * clean page must take the walk once more so the D update reaches memory.
+ */
+static uint8_t rv32emu_tlb_leaf_perm(uint32_t pte, rv32emu_priv_t priv, uint32_t mstatus) {
+  bool readable = (pte & PTE_R) != 0u;
+  bool writable = (pte & PTE_W) != 0u;
+  bool executable = (pte & PTE_X) != 0u;
+  bool user_page = (pte & PTE_U) != 0u;
+  uint8_t perm = 0u;
+
+  if (priv == RV32EMU_PRIV_U && !user_page) {
+    return 0u;
+  }
+  if (priv == RV32EMU_PRIV_S && user_page && (mstatus & MSTATUS_SUM) == 0u) {
+    return 0u;
+  }
+
+  if (executable && !(priv == RV32EMU_PRIV_S && user_page)) {
+    perm |= (uint8_t)(1u << RV32EMU_ACC_FETCH);
+  }
+  if (readable || (((mstatus & MSTATUS_MXR) != 0u) && executable)) {
+    perm |= (uint8_t)(1u << RV32EMU_ACC_LOAD);
+  }
+  if (writable && (pte & PTE_D) != 0u) {
+    perm |= (uint8_t)(1u << RV32EMU_ACC_STORE);
+  }
+  return perm;
 }
 
 static void rv32emu_raise_page_fault(rv32emu_machine_t *m, rv32emu_access_t access,
@@ -84,6 +278,7 @@ static void rv32emu_take_trap(rv32emu_machine_t *m, uint32_t cause, uint32_t tva
   uint32_t deleg_mask;
   bool delegated_to_s = false;
   uint32_t tvec_mode;
+  rv32emu_priv_t prev_priv = RV32EMU_CPU(m)->priv;
 
   if (is_interrupt) {
     cause_value |= 0x80000000u;
@@ -122,8 +317,12 @@ static void rv32emu_take_trap(rv32emu_machine_t *m, uint32_t cause, uint32_t tva
 
     RV32EMU_CPU(m)->csr[CSR_MSTATUS] = mstatus;
     RV32EMU_CPU(m)->priv = RV32EMU_PRIV_S;
+    rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
     RV32EMU_CPU(m)->pc = stvec_base;
     atomic_store_explicit(&RV32EMU_CPU(m)->running, stvec_base != 0u, memory_order_release);
+    if (prev_priv != RV32EMU_PRIV_S) {
+      rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+    }
     return;
   }
 
@@ -151,13 +350,32 @@ static void rv32emu_take_trap(rv32emu_machine_t *m, uint32_t cause, uint32_t tva
 
     RV32EMU_CPU(m)->csr[CSR_MSTATUS] = mstatus;
     RV32EMU_CPU(m)->priv = RV32EMU_PRIV_M;
+    rv32emu_cpu_irq_recheck(RV32EMU_CPU(m));
     RV32EMU_CPU(m)->pc = mtvec_base;
     atomic_store_explicit(&RV32EMU_CPU(m)->running, mtvec_base != 0u, memory_order_release);
+    if (prev_priv != RV32EMU_PRIV_M) {
+      rv32emu_tlb_flush(m, RV32EMU_CPU(m));
+    }
   }
 }
 
-bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t access,
-                       uint32_t *paddr_out) {
+static bool rv32emu_translate_fault(rv32emu_machine_t *m, rv32emu_access_t access, uint32_t vaddr,
+                                    bool probe) {
+  if (!probe) {
+    rv32emu_raise_page_fault(m, access, vaddr);
+  }
+  return false;
+}
+
+/*
+ * Translate vaddr and, when the target page is plain DRAM, also report the
+ * host address of that page (host_page_out may be NULL). TLB entries keep the
+ * host page pointer so a hit needs neither a walk nor a DRAM bounds check.
+ * A probe reports failure without trapping and never writes A/D: a walk
+ * that would need to set them fails instead.
+ */
+static bool rv32emu_translate_host(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t access,
+                                   bool probe, uint32_t *paddr_out, uint8_t **host_page_out) {
   uint32_t satp;
   uint32_t mstatus;
   rv32emu_priv_t effective_priv;
@@ -165,12 +383,19 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
   uint32_t vpn1;
   uint32_t vpn0;
   uint32_t vpn[2];
+  rv32emu_cpu_t *cpu;
+  rv32emu_tlb_entry_t *tlb_entry = NULL;
+  rv32emu_tlb_entry_t *mega_entry;
+  rv32emu_pwc_entry_t *walk_entry = NULL;
+  int start_level = 1;
+  uint8_t tlb_ctx;
 
   if (m == NULL || paddr_out == NULL) {
     return false;
   }
 
-  satp = RV32EMU_CPU(m)->csr[CSR_SATP];
+  cpu = RV32EMU_CPU(m);
+  satp = cpu->csr[CSR_SATP];
   mstatus = rv32emu_csr_read(m, CSR_MSTATUS);
   effective_priv = RV32EMU_CPU(m)->priv;
 
@@ -182,15 +407,60 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
 
   if ((satp & SATP_MODE_SV32) == 0 || effective_priv == RV32EMU_PRIV_M) {
     *paddr_out = vaddr;
+    if (host_page_out != NULL) {
+      *host_page_out = rv32emu_dram_page(m, vaddr & ~0xfffu);
+    }
     return true;
   }
 
+  tlb_ctx = (uint8_t)effective_priv;
+  if ((mstatus & MSTATUS_SUM) != 0u) {
+    tlb_ctx |= TLB_CTX_SUM;
+  }
+  if ((mstatus & MSTATUS_MXR) != 0u) {
+    tlb_ctx |= TLB_CTX_MXR;
+  }
+  if (m->opts.tlb_entries != 0u) {
+    rv32emu_tlb_entry_t *tlb = (access == RV32EMU_ACC_FETCH) ? cpu->itlb : cpu->dtlb;
+
+    tlb_entry = &tlb[(vaddr >> 12) & (m->opts.tlb_entries - 1u)];
+    if (tlb_entry->valid && tlb_entry->vpn == (vaddr >> 12) && tlb_entry->satp == satp &&
+        tlb_entry->ctx == tlb_ctx && (tlb_entry->perm & (1u << access)) != 0u) {
+      rv32emu_tlb_stat_inc(m, &m->plat.tlb_hits);
+      *paddr_out = (tlb_entry->ppn << 12) | (vaddr & 0xfffu);
+      if (host_page_out != NULL) {
+        *host_page_out = tlb_entry->host_page;
+      }
+      return true;
+    }
+    mega_entry = rv32emu_mtlb_find(cpu, vaddr, satp, tlb_ctx);
+    if (mega_entry != NULL && (mega_entry->perm & (1u << access)) != 0u) {
+      rv32emu_tlb_stat_inc(m, &m->plat.tlb_hits);
+      *paddr_out = (mega_entry->ppn << 22) | (vaddr & 0x3fffffu);
+      if (host_page_out != NULL) {
+        *host_page_out = (mega_entry->host_page != NULL)
+                             ? mega_entry->host_page + (vaddr & 0x3ff000u)
+                             : rv32emu_dram_page(m, *paddr_out & ~0xfffu);
+      }
+      return true;
+    }
+    rv32emu_tlb_stat_inc(m, &m->plat.tlb_misses);
+  }
+
   pt_addr = (satp & SATP_PPN_MASK) << 12;
   vpn1 = (vaddr >> 22) & 0x3ffu;
   vpn0 = (vaddr >> 12) & 0x3ffu;
   vpn[1] = vpn1;
   vpn[0] = vpn0;
-  for (int level = 1; level >= 0; level--) {
+  if (m->opts.tlb_entries != 0u) {
+    walk_entry = &cpu->pwc[vpn1 & (RV32EMU_PWC_ENTRIES - 1u)];
+    if (walk_entry->valid && walk_entry->vpn1 == vpn1 && walk_entry->satp == satp) {
+      rv32emu_tlb_stat_inc(m, &m->plat.pwc_hits);
+      pt_addr = walk_entry->table;
+      start_level = 0;
+    }
+  }
+  for (int level = start_level; level >= 0; level--) {
     uint32_t pte_addr = pt_addr + vpn[level] * 4u;
     uint32_t pte = 0;
     uint32_t pte_flags;
@@ -207,8 +477,7 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
     uint32_t pa_ppn1;
 
     if (!rv32emu_phys_read(m, pte_addr, 4, &pte)) {
-      rv32emu_raise_page_fault(m, access, vaddr);
-      return false;
+      return rv32emu_translate_fault(m, access, vaddr, probe);
     }
 
     pte_flags = pte & 0x3ffu;
@@ -219,30 +488,32 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
     leaf = readable || executable;
 
     if ((pte_flags & PTE_V) == 0u || (!readable && writable)) {
-      rv32emu_raise_page_fault(m, access, vaddr);
-      return false;
+      return rv32emu_translate_fault(m, access, vaddr, probe);
     }
 
     if (!leaf) {
       if (level == 0) {
-        rv32emu_raise_page_fault(m, access, vaddr);
-        return false;
+        return rv32emu_translate_fault(m, access, vaddr, probe);
       }
       pt_addr = ((pte >> 10) & SATP_PPN_MASK) << 12;
+      if (walk_entry != NULL) {
+        walk_entry->satp = satp;
+        walk_entry->vpn1 = (uint16_t)vpn1;
+        walk_entry->table = pt_addr;
+        walk_entry->valid = true;
+      }
       continue;
     }
 
     if (effective_priv == RV32EMU_PRIV_U && !user_page) {
-      rv32emu_raise_page_fault(m, access, vaddr);
-      return false;
+      return rv32emu_translate_fault(m, access, vaddr, probe);
     }
 
     if (effective_priv == RV32EMU_PRIV_S && user_page) {
       if (access == RV32EMU_ACC_FETCH ||
           ((access == RV32EMU_ACC_LOAD || access == RV32EMU_ACC_STORE) &&
            (mstatus & MSTATUS_SUM) == 0u)) {
-        rv32emu_raise_page_fault(m, access, vaddr);
-        return false;
+        return rv32emu_translate_fault(m, access, vaddr, probe);
       }
     }
 
@@ -254,26 +525,26 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
       allow_access = writable;
     }
     if (!allow_access) {
-      rv32emu_raise_page_fault(m, access, vaddr);
-      return false;
+      return rv32emu_translate_fault(m, access, vaddr, probe);
     }
 
     if ((pte_flags & PTE_A) == 0u || (access == RV32EMU_ACC_STORE && (pte_flags & PTE_D) == 0u)) {
+      if (probe) {
+        return false; /* leave A/D to the architectural access */
+      }
       pte |= PTE_A;
       if (access == RV32EMU_ACC_STORE) {
         pte |= PTE_D;
       }
       if (!rv32emu_phys_write(m, pte_addr, 4, pte)) {
-        rv32emu_raise_page_fault(m, access, vaddr);
-        return false;
+        return rv32emu_translate_fault(m, access, vaddr, probe);
       }
     }
 
     pte_ppn0 = (pte >> 10) & 0x3ffu;
     pte_ppn1 = (pte >> 20) & 0xfffu;
     if (level == 1 && pte_ppn0 != 0u) {
-      rv32emu_raise_page_fault(m, access, vaddr);
-      return false;
+      return rv32emu_translate_fault(m, access, vaddr, probe);
     }
 
     offset = vaddr & 0xfffu;
@@ -285,21 +556,228 @@ bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t ac
       pa_ppn0 = pte_ppn0;
     }
     *paddr_out = (pa_ppn1 << 22) | (pa_ppn0 << 12) | offset;
+    if (tlb_entry != NULL && level == 1) {
+      rv32emu_mtlb_fill(m, cpu, vaddr, *paddr_out, satp, tlb_ctx,
+                        rv32emu_tlb_leaf_perm(pte, effective_priv, mstatus));
+    } else if (tlb_entry != NULL) {
+      tlb_entry->vpn = vaddr >> 12;
+      tlb_entry->ppn = *paddr_out >> 12;
+      tlb_entry->satp = satp;
+      tlb_entry->ctx = tlb_ctx;
+      tlb_entry->perm = rv32emu_tlb_leaf_perm(pte, effective_priv, mstatus);
+      tlb_entry->host_page = rv32emu_dram_page(m, *paddr_out & ~0xfffu);
+      tlb_entry->valid = tlb_entry->perm != 0u;
+    }
+    if (host_page_out != NULL) {
+      *host_page_out = rv32emu_dram_page(m, *paddr_out & ~0xfffu);
+    }
     return true;
   }
 
-  rv32emu_raise_page_fault(m, access, vaddr);
-  return false;
+  return rv32emu_translate_fault(m, access, vaddr, probe);
+}
+
+bool rv32emu_translate(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_access_t access,
+                       uint32_t *paddr_out) {
+  return rv32emu_translate_host(m, vaddr, access, false, paddr_out, NULL);
+}
+
+bool rv32emu_translate_fetch(rv32emu_machine_t *m, uint32_t vaddr, bool probe, uint32_t *paddr_out,
+                             uint8_t **host_page_out) {
+  return rv32emu_translate_host(m, vaddr, RV32EMU_ACC_FETCH, probe, paddr_out, host_page_out);
+}
+
+/*
+ * Host-pointer fast path: a naturally aligned 1/2/4-byte access never crosses
+ * a page, so once translation yields a DRAM host page it is one host load or
+ * store. Relaxed atomics compile to plain moves and stay race-free against
+ * other hart threads; MMIO and non-DRAM accesses use phys_*, misaligned ones
+ * the span path below.
+ */
+static inline bool rv32emu_host_fast_ok(uint32_t vaddr, int len) {
+  return (len == 1 || len == 2 || len == 4) && (vaddr & (uint32_t)(len - 1)) == 0u;
+}
+
+static inline uint32_t rv32emu_host_load(const uint8_t *p, int len) {
+  if (len == 4) {
+    return __atomic_load_n((const uint32_t *)(const void *)p, __ATOMIC_RELAXED);
+  }
+  if (len == 2) {
+    return (uint32_t)__atomic_load_n((const uint16_t *)(const void *)p, __ATOMIC_RELAXED);
+  }
+  return (uint32_t)__atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void rv32emu_host_store(uint8_t *p, int len, uint32_t data) {
+  if (len == 4) {
+    __atomic_store_n((uint32_t *)(void *)p, data, __ATOMIC_RELAXED);
+  } else if (len == 2) {
+    __atomic_store_n((uint16_t *)(void *)p, (uint16_t)data, __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(p, (uint8_t)data, __ATOMIC_RELAXED);
+  }
+}
+
+/* Keep RV32EMU_DEBUG_DRAM_STATS totals comparable with the phys_* atomic path. */
+static void rv32emu_host_fast_stat(rv32emu_machine_t *m, int len, bool is_write) {
+  atomic_uint_fast64_t *counter;
+
+  if (!m->plat.dram_atomic_stats_enable || !m->threaded_exec_active) {
+    return;
+  }
+  if (len == 4) {
+    counter = is_write ? &m->plat.dram_atomic_write_aligned32 : &m->plat.dram_atomic_read_aligned32;
+  } else if (len == 2) {
+    counter = is_write ? &m->plat.dram_atomic_write_aligned16 : &m->plat.dram_atomic_read_aligned16;
+  } else {
+    counter = is_write ? &m->plat.dram_atomic_write_bytepath : &m->plat.dram_atomic_read_bytepath;
+  }
+  atomic_fetch_add_explicit(counter, 1u, memory_order_relaxed);
+}
+
+/*
+ * Misaligned access: translate each page the access touches once (at most
+ * two), then move bytes directly. Both pages are translated before any byte
+ * moves, so a page fault on the second page leaves memory untouched and
+ * reports the first byte of that page, as a byte-by-byte access would.
+ * Non-DRAM bytes still go through phys_* one byte at a time.
+ */
+typedef struct {
+  uint32_t paddr[2];
+  uint8_t *host_page[2];
+  uint32_t split; /* bytes on the first page */
+} rv32emu_unaligned_span_t;
+
+static bool rv32emu_unaligned_translate(rv32emu_machine_t *m, uint32_t vaddr, int len,
+                                        rv32emu_access_t access,
+                                        rv32emu_unaligned_span_t *span) {
+  uint32_t page_off = vaddr & 0xfffu;
+
+  span->host_page[0] = NULL;
+  span->host_page[1] = NULL;
+  span->split = (uint32_t)len;
+  if (!rv32emu_translate_host(m, vaddr, access, false, &span->paddr[0], &span->host_page[0])) {
+    return false;
+  }
+  if (page_off + (uint32_t)len <= 4096u) {
+    return true;
+  }
+  span->split = 4096u - page_off;
+  return rv32emu_translate_host(m, vaddr + span->split, access, false, &span->paddr[1],
+                                &span->host_page[1]);
+}
+
+static bool rv32emu_virt_read_unaligned(rv32emu_machine_t *m, uint32_t vaddr, int len,
+                                        rv32emu_access_t access, uint32_t *out) {
+  rv32emu_unaligned_span_t span;
+  uint32_t value = 0u;
+
+  if (!rv32emu_unaligned_translate(m, vaddr, len, access, &span)) {
+    return false;
+  }
+
+  for (uint32_t i = 0u; i < (uint32_t)len; i++) {
+    uint32_t page = i < span.split ? 0u : 1u;
+    uint32_t va = vaddr + i;
+    uint32_t byte = 0u;
+
+    if (span.host_page[page] != NULL) {
+      byte = __atomic_load_n(span.host_page[page] + (va & 0xfffu), __ATOMIC_RELAXED);
+    } else if (!rv32emu_phys_read(m, span.paddr[page] + (i - page * span.split), 1, &byte)) {
+      fprintf(stderr, "[WARN] virt_read access fault: va=0x%08x pa=0x%08x len=%d acc=%d\n", va,
+              span.paddr[page] + (i - page * span.split), 1, (int)access);
+      rv32emu_raise_access_fault(m, access, va);
+      return false;
+    }
+    value |= (byte & 0xffu) << (8u * i);
+  }
+
+  *out = value;
+  return true;
+}
+
+static bool rv32emu_virt_write_unaligned(rv32emu_machine_t *m, uint32_t vaddr, int len,
+                                         rv32emu_access_t access, uint32_t data) {
+  rv32emu_unaligned_span_t span;
+
+  if (!rv32emu_unaligned_translate(m, vaddr, len, access, &span)) {
+    return false;
+  }
+
+  for (uint32_t i = 0u; i < (uint32_t)len; i++) {
+    uint32_t page = i < span.split ? 0u : 1u;
+    uint32_t va = vaddr + i;
+    uint8_t byte = (uint8_t)(data >> (8u * i));
+
+    if (span.host_page[page] != NULL) {
+      __atomic_store_n(span.host_page[page] + (va & 0xfffu), byte, __ATOMIC_RELAXED);
+    } else if (!rv32emu_phys_write(m, span.paddr[page] + (i - page * span.split), 1, byte)) {
+      fprintf(stderr, "[WARN] virt_write access fault: va=0x%08x pa=0x%08x len=%d acc=%d\n", va,
+              span.paddr[page] + (i - page * span.split), 1, (int)access);
+      rv32emu_raise_access_fault(m, access, va);
+      return false;
+    }
+  }
+
+  /* phys_write already marked any DRAM bytes it took; this covers the host copy. */
+  if (span.host_page[0] != NULL) {
+    rv32emu_note_dram_write(m, span.paddr[0], span.split);
+  }
+  if (span.host_page[1] != NULL) {
+    rv32emu_note_dram_write(m, span.paddr[1], (uint32_t)len - span.split);
+  }
+  rv32emu_invalidate_lr_reservations(m, vaddr, len);
+  return true;
+}
+
+/*
+ * Flat window with translation off (bare satp, or M-mode without MPRV on a
+ * data access): the host address is phys_window + vaddr, with no TLB probe
+ * and no phys_map lookup. Aligned accesses only; anything else returns NULL.
+ */
+static inline uint8_t *rv32emu_virt_flat_ptr(rv32emu_machine_t *m, uint32_t vaddr, int len,
+                                             rv32emu_access_t access) {
+  const rv32emu_cpu_t *cpu;
+
+  if (m->plat.phys_window == NULL || !rv32emu_host_fast_ok(vaddr, len)) {
+    return NULL;
+  }
+  cpu = RV32EMU_CPU(m);
+  if ((cpu->csr[CSR_SATP] & SATP_MODE_SV32) != 0u &&
+      (cpu->priv != RV32EMU_PRIV_M ||
+       (access != RV32EMU_ACC_FETCH && (cpu->csr[CSR_MSTATUS] & MSTATUS_MPRV) != 0u))) {
+    return NULL;
+  }
+  return rv32emu_phys_flat_ptr(m, vaddr, (uint32_t)len);
 }
 
 bool rv32emu_virt_read(rv32emu_machine_t *m, uint32_t vaddr, int len,
                        rv32emu_access_t access, uint32_t *out) {
   uint32_t paddr;
+  uint8_t *host_page = NULL;
+  uint8_t *host;
+
+  if (len > 1 && (vaddr & (uint32_t)(len - 1)) != 0u) {
+    return rv32emu_virt_read_unaligned(m, vaddr, len, access, out);
+  }
 
-  if (!rv32emu_translate(m, vaddr, access, &paddr)) {
+  host = rv32emu_virt_flat_ptr(m, vaddr, len, access);
+  if (host != NULL) {
+    rv32emu_host_fast_stat(m, len, false);
+    *out = rv32emu_host_load(host, len);
+    return true;
+  }
+
+  if (!rv32emu_translate_host(m, vaddr, access, false, &paddr, &host_page)) {
     return false;
   }
 
+  if (host_page != NULL && rv32emu_host_fast_ok(vaddr, len)) {
+    rv32emu_host_fast_stat(m, len, false);
+    *out = rv32emu_host_load(host_page + (vaddr & 0xfffu), len);
+    return true;
+  }
+
   if (!rv32emu_phys_read(m, paddr, len, out)) {
     fprintf(stderr, "[WARN] virt_read access fault: va=0x%08x pa=0x%08x len=%d acc=%d\n", vaddr,
             paddr, len, (int)access);
@@ -313,12 +791,25 @@ bool rv32emu_virt_read(rv32emu_machine_t *m, uint32_t vaddr, int len,
 bool rv32emu_virt_write(rv32emu_machine_t *m, uint32_t vaddr, int len,
                         rv32emu_access_t access, uint32_t data) {
   uint32_t paddr;
+  uint8_t *host_page = NULL;
+  uint8_t *host;
 
-  if (!rv32emu_translate(m, vaddr, access, &paddr)) {
-    return false;
+  if (len > 1 && (vaddr & (uint32_t)(len - 1)) != 0u) {
+    return rv32emu_virt_write_unaligned(m, vaddr, len, access, data);
   }
 
-  if (!rv32emu_phys_write(m, paddr, len, data)) {
+  host = rv32emu_virt_flat_ptr(m, vaddr, len, access);
+  if (host != NULL) {
+    rv32emu_host_fast_stat(m, len, true);
+    rv32emu_host_store(host, len, data);
+    rv32emu_note_dram_write(m, vaddr, (uint32_t)len);
+  } else if (!rv32emu_translate_host(m, vaddr, access, false, &paddr, &host_page)) {
+    return false;
+  } else if (host_page != NULL && rv32emu_host_fast_ok(vaddr, len)) {
+    rv32emu_host_fast_stat(m, len, true);
+    rv32emu_host_store(host_page + (vaddr & 0xfffu), len, data);
+    rv32emu_note_dram_write(m, paddr, (uint32_t)len);
+  } else if (!rv32emu_phys_write(m, paddr, len, data)) {
     fprintf(stderr, "[WARN] virt_write access fault: va=0x%08x pa=0x%08x len=%d acc=%d\n", vaddr,
             paddr, len, (int)access);
     rv32emu_raise_access_fault(m, access, vaddr);
@@ -336,6 +827,146 @@ bool rv32emu_virt_write(rv32emu_machine_t *m, uint32_t vaddr, int len,
   return true;
 }
 
+/*
+ * A-extension word atomics. DRAM targets run as one host atomic RMW on the
+ * translated host pointer (xchg/lock xadd/lock cmpxchg on x86), so harts
+ * never serialize on a mutex for guest spinlocks and counters. Only non-DRAM
+ * targets fall back to plat.amo_lock around a phys read/write pair. AMOs need
+ * store permission, so translation uses RV32EMU_ACC_STORE.
+ */
+static uint32_t rv32emu_amo_apply(rv32emu_amo_op_t op, uint32_t old_val, uint32_t operand) {
+  switch (op) {
+  case RV32EMU_AMO_SWAP:
+    return operand;
+  case RV32EMU_AMO_ADD:
+    return old_val + operand;
+  case RV32EMU_AMO_XOR:
+    return old_val ^ operand;
+  case RV32EMU_AMO_AND:
+    return old_val & operand;
+  case RV32EMU_AMO_OR:
+    return old_val | operand;
+  case RV32EMU_AMO_MIN:
+    return ((int32_t)old_val < (int32_t)operand) ? old_val : operand;
+  case RV32EMU_AMO_MAX:
+    return ((int32_t)old_val > (int32_t)operand) ? old_val : operand;
+  case RV32EMU_AMO_MINU:
+    return (old_val < operand) ? old_val : operand;
+  case RV32EMU_AMO_MAXU:
+    return (old_val > operand) ? old_val : operand;
+  }
+  return old_val;
+}
+
+static uint32_t rv32emu_amo_host(uint32_t *p, rv32emu_amo_op_t op, uint32_t operand) {
+  uint32_t old_val;
+
+  switch (op) {
+  case RV32EMU_AMO_SWAP:
+    return __atomic_exchange_n(p, operand, __ATOMIC_SEQ_CST);
+  case RV32EMU_AMO_ADD:
+    return __atomic_fetch_add(p, operand, __ATOMIC_SEQ_CST);
+  case RV32EMU_AMO_XOR:
+    return __atomic_fetch_xor(p, operand, __ATOMIC_SEQ_CST);
+  case RV32EMU_AMO_AND:
+    return __atomic_fetch_and(p, operand, __ATOMIC_SEQ_CST);
+  case RV32EMU_AMO_OR:
+    return __atomic_fetch_or(p, operand, __ATOMIC_SEQ_CST);
+  default:
+    break;
+  }
+
+  old_val = __atomic_load_n(p, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(p, &old_val, rv32emu_amo_apply(op, old_val, operand), true,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+  }
+  return old_val;
+}
+
+static bool rv32emu_amo_translate(rv32emu_machine_t *m, uint32_t vaddr, uint32_t *paddr_out,
+                                  uint32_t **host_out) {
+  uint8_t *host_page = NULL;
+
+  if (!rv32emu_translate_host(m, vaddr, RV32EMU_ACC_STORE, false, paddr_out, &host_page)) {
+    return false;
+  }
+  *host_out = host_page != NULL ? (uint32_t *)(void *)(host_page + (vaddr & 0xfffu)) : NULL;
+  return true;
+}
+
+bool rv32emu_virt_amo32(rv32emu_machine_t *m, uint32_t vaddr, rv32emu_amo_op_t op,
+                        uint32_t operand, uint32_t *old_out) {
+  uint32_t paddr;
+  uint32_t *host;
+  uint32_t old_val = 0u;
+  bool ok;
+
+  if (!rv32emu_amo_translate(m, vaddr, &paddr, &host)) {
+    return false;
+  }
+
+  if (host != NULL) {
+    *old_out = rv32emu_amo_host(host, op, operand);
+    rv32emu_note_dram_write(m, paddr, 4u);
+    rv32emu_invalidate_lr_reservations(m, vaddr, 4);
+    return true;
+  }
+
+  if (!rv32emu_plat_lock(m, &m->plat.amo_lock)) {
+    return false;
+  }
+  ok = rv32emu_phys_read(m, paddr, 4, &old_val) &&
+       rv32emu_phys_write(m, paddr, 4, rv32emu_amo_apply(op, old_val, operand));
+  rv32emu_plat_unlock(&m->plat.amo_lock);
+  if (!ok) {
+    fprintf(stderr, "[WARN] virt_amo32 access fault: va=0x%08x pa=0x%08x\n", vaddr, paddr);
+    rv32emu_raise_access_fault(m, RV32EMU_ACC_STORE, vaddr);
+    return false;
+  }
+
+  *old_out = old_val;
+  rv32emu_invalidate_lr_reservations(m, vaddr, 4);
+  return true;
+}
+
+bool rv32emu_virt_cas32(rv32emu_machine_t *m, uint32_t vaddr, uint32_t expected,
+                        uint32_t desired, bool *swapped_out) {
+  uint32_t paddr;
+  uint32_t *host;
+  uint32_t cur = 0u;
+  bool ok;
+
+  if (!rv32emu_amo_translate(m, vaddr, &paddr, &host)) {
+    return false;
+  }
+
+  if (host != NULL) {
+    *swapped_out = __atomic_compare_exchange_n(host, &expected, desired, false, __ATOMIC_SEQ_CST,
+                                               __ATOMIC_RELAXED);
+  } else {
+    if (!rv32emu_plat_lock(m, &m->plat.amo_lock)) {
+      return false;
+    }
+    ok = rv32emu_phys_read(m, paddr, 4, &cur);
+    *swapped_out = ok && cur == expected;
+    if (*swapped_out) {
+      ok = rv32emu_phys_write(m, paddr, 4, desired);
+    }
+    rv32emu_plat_unlock(&m->plat.amo_lock);
+    if (!ok) {
+      fprintf(stderr, "[WARN] virt_cas32 access fault: va=0x%08x pa=0x%08x\n", vaddr, paddr);
+      rv32emu_raise_access_fault(m, RV32EMU_ACC_STORE, vaddr);
+      return false;
+    }
+  }
+
+  if (*swapped_out) {
+    rv32emu_note_dram_write(m, paddr, 4u);
+    rv32emu_invalidate_lr_reservations(m, vaddr, 4);
+  }
+  return true;
+}
+
 void rv32emu_raise_exception(rv32emu_machine_t *m, uint32_t cause, uint32_t tval) {
   if (m == NULL) {
     return;
@@ -351,8 +982,13 @@ void rv32emu_raise_interrupt(rv32emu_machine_t *m, uint32_t cause_num) {
   rv32emu_cpu_mip_set_bits(RV32EMU_CPU(m), (1u << cause_num));
 }
 
-bool rv32emu_check_pending_interrupt(rv32emu_machine_t *m) {
-  rv32emu_cpu_t *cpu;
+/*
+ * Slow path of rv32emu_check_pending_interrupt(), taken while irq_check is
+ * set: clear it, apply a posted TLB fence, then pick the highest-priority
+ * deliverable interrupt. With nothing deliverable the flag stays clear until
+ * the next change that could alter the answer.
+ */
+bool rv32emu_scan_pending_interrupt(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
   uint32_t enabled_pending;
   uint32_t mstatus;
   uint32_t mideleg;
@@ -361,13 +997,11 @@ bool rv32emu_check_pending_interrupt(rv32emu_machine_t *m) {
   uint32_t priority[] = {RV32EMU_IRQ_MEIP, RV32EMU_IRQ_MSIP, RV32EMU_IRQ_MTIP,
                          RV32EMU_IRQ_SEIP, RV32EMU_IRQ_SSIP, RV32EMU_IRQ_STIP};
 
-  if (m == NULL) {
-    return false;
-  }
-  cpu = RV32EMU_CPU(m);
-  if (cpu == NULL) {
+  if (m == NULL || cpu == NULL) {
     return false;
   }
+  (void)atomic_exchange_explicit(&cpu->irq_check, false, memory_order_seq_cst);
+  rv32emu_tlb_sync_fence(m, cpu);
   enabled_pending = cpu->csr[CSR_MIE] & rv32emu_cpu_mip_load(cpu);
   mstatus = cpu->csr[CSR_MSTATUS];
   mideleg = cpu->csr[CSR_MIDELEG];
@@ -24,6 +24,11 @@
 #define RV32EMU_JIT_STRUCT_TEMPLATE_LINES 1024u
 #define RV32EMU_JIT_MAX_PC_RELOCS (RV32EMU_TB_MAX_INSNS + 8u)
 
+/* Time-polling loops: iterations before warping, first and largest mtime jump. */
+#define RV32EMU_TB_SPIN_MIN_ITERS 8u
+#define RV32EMU_TB_SPIN_WARP_MIN_TICKS 64u
+#define RV32EMU_TB_SPIN_WARP_MAX_TICKS 4096u
+
 #define RV32EMU_JIT_STATE_NONE 0u
 #define RV32EMU_JIT_STATE_QUEUED 1u
 #define RV32EMU_JIT_STATE_READY 2u
@@ -53,6 +58,9 @@ typedef struct {
   atomic_uint_fast64_t helper_cf_calls;
   atomic_uint_fast64_t chain_hits;
   atomic_uint_fast64_t chain_misses;
+  atomic_uint_fast64_t code_invalidations;
+  atomic_uint_fast64_t fence_invalidations;
+  atomic_uint_fast64_t tb_builds;
   atomic_uint_fast64_t async_jobs_enqueued;
   atomic_uint_fast64_t async_jobs_dropped;
   atomic_uint_fast64_t async_jobs_compiled;
@@ -113,6 +121,51 @@ uint8_t rv32emu_tb_jit_async_busy_pct_from_env(void);
 uint8_t rv32emu_tb_jit_async_hot_discount_from_env(void);
 uint8_t rv32emu_tb_jit_async_hot_bonus_from_env(void);
 
+/*
+ * A line is current while every DRAM page it was decoded from still carries
+ * the code version saved at build time: one load per page instead of
+ * re-fetching each instruction.
+ */
+static inline bool rv32emu_tb_line_code_current(const rv32emu_machine_t *m,
+                                                const rv32emu_tb_line_t *line) {
+  for (uint8_t i = 0u; i < line->code_page_count; i++) {
+    if (atomic_load_explicit(&m->plat.code_version[line->code_page[i]], memory_order_acquire) !=
+        line->code_version[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void rv32emu_tb_cache_apply_fence(rv32emu_tb_cache_t *cache, uint32_t req);
+
+/*
+ * Run before each lookup outside native code:
+ * - drop lines named by fence.i / sfence.vma / SBI rfence;
+ * - latch the fetch context. Lines are keyed by (start_pc, satp, priv) while
+ *   Sv32 is on, so each address space keeps its own lines across context
+ *   switches; bare and M-mode fetches share one identity-mapped context.
+ */
+static inline void rv32emu_tb_cache_sync(rv32emu_tb_cache_t *cache, rv32emu_cpu_t *cpu) {
+  uint32_t satp = cpu->csr[CSR_SATP];
+  uint8_t priv = (uint8_t)cpu->priv;
+
+  if (atomic_load_explicit(&cpu->tb_fence, memory_order_relaxed) != 0u) {
+    rv32emu_tb_cache_apply_fence(
+        cache, atomic_exchange_explicit(&cpu->tb_fence, 0u, memory_order_acquire));
+  }
+  if ((satp & (1u << 31)) == 0u || priv == RV32EMU_PRIV_M) {
+    satp = 0u;
+    priv = RV32EMU_PRIV_M;
+  }
+  if (satp != cache->ctx_satp || priv != cache->ctx_priv) {
+    cache->ctx_satp = satp;
+    cache->ctx_priv = priv;
+    cache->ctx_mix = (uint8_t)(((satp ^ priv) * 0x9e3779b1u) >> 24);
+    cache->active = false;
+  }
+}
+
 uint32_t rv32emu_tb_next_jit_generation(void);
 rv32emu_tb_line_t *rv32emu_tb_find_cached_line(rv32emu_tb_cache_t *cache, uint32_t pc);
 rv32emu_tb_line_t *rv32emu_tb_lookup_or_build(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache,
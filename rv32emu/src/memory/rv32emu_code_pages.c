@@ -0,0 +1,44 @@
+#include "rv32emu.h"
+
+#include <stdlib.h>
+
+#define CODE_PAGE_SHIFT 12u
+
+/*
+ * Per-page code versions for translated-code invalidation:
+ * - allocated for every machine; untouched entries stay on lazily zeroed pages;
+ * - rv32emu_code_watch_page() sets the low bit so the store path
+ *   (rv32emu_code_note_write) knows the page backs a TB line;
+ * - a write to a watched page increments the counter, clearing the bit and
+ *   changing the value every line on that page saved.
+ */
+bool rv32emu_code_version_init(rv32emu_machine_t *m) {
+  uint32_t pages = (m->plat.dram_size + (1u << CODE_PAGE_SHIFT) - 1u) >> CODE_PAGE_SHIFT;
+
+  m->plat.code_version = calloc(pages, sizeof(*m->plat.code_version));
+  return m->plat.code_version != NULL;
+}
+
+void rv32emu_code_version_destroy(rv32emu_machine_t *m) {
+  free(m->plat.code_version);
+  m->plat.code_version = NULL;
+}
+
+bool rv32emu_code_watch_page(rv32emu_machine_t *m, uint32_t paddr, uint32_t *page_out,
+                             uint32_t *version_out) {
+  uint32_t off;
+
+  if (m == NULL || m->plat.code_version == NULL || paddr < m->plat.dram_base) {
+    return false;
+  }
+  off = paddr - m->plat.dram_base;
+  if (off >= m->plat.dram_size) {
+    return false;
+  }
+
+  *page_out = off >> CODE_PAGE_SHIFT;
+  *version_out = atomic_fetch_or_explicit(&m->plat.code_version[*page_out], 1u,
+                                          memory_order_acq_rel) |
+                 1u;
+  return true;
+}
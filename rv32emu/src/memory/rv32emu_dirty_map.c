@@ -0,0 +1,99 @@
+#include "rv32emu.h"
+
+#include <stdlib.h>
+
+#define DIRTY_PAGE_SHIFT 12u
+
+/*
+ * DRAM dirty map:
+ * - one byte per 4 KiB page, written by rv32emu_dirty_mark() on every
+ *   committed DRAM store (phys_write, virt_write host path, AMOs, loaders);
+ * - the map is padded to a multiple of 8 bytes so scans read it a 64-bit
+ *   word at a time and only look at individual bytes inside non-zero words;
+ * - clearing swaps a non-zero word with zero, so a mark racing with a scan
+ *   is either reported now or left set for the next scan, never lost.
+ */
+bool rv32emu_dirty_map_init(rv32emu_machine_t *m) {
+  uint32_t pages = (m->plat.dram_size + (1u << DIRTY_PAGE_SHIFT) - 1u) >> DIRTY_PAGE_SHIFT;
+  size_t bytes = ((size_t)pages + 7u) & ~(size_t)7u;
+
+  m->plat.dirty_map = calloc(bytes, 1u);
+  if (m->plat.dirty_map == NULL) {
+    return false;
+  }
+  m->plat.dirty_pages = pages;
+  return true;
+}
+
+void rv32emu_dirty_map_destroy(rv32emu_machine_t *m) {
+  free(m->plat.dirty_map);
+  m->plat.dirty_map = NULL;
+  m->plat.dirty_pages = 0u;
+}
+
+static uint32_t rv32emu_dirty_scan_byte(rv32emu_machine_t *m, uint32_t page, bool clear,
+                                        rv32emu_dirty_page_fn fn, void *opaque) {
+  uint8_t *p = &m->plat.dirty_map[page];
+
+  if (__atomic_load_n(p, __ATOMIC_RELAXED) == 0u) {
+    return 0u;
+  }
+  if (clear && __atomic_exchange_n(p, (uint8_t)0u, __ATOMIC_ACQ_REL) == 0u) {
+    return 0u;
+  }
+  if (fn != NULL) {
+    fn(opaque, m->plat.dram_base + (page << DIRTY_PAGE_SHIFT));
+  }
+  return 1u;
+}
+
+uint32_t rv32emu_dirty_scan(rv32emu_machine_t *m, uint32_t paddr, uint32_t size, bool clear,
+                            rv32emu_dirty_page_fn fn, void *opaque) {
+  uint32_t off;
+  uint32_t page;
+  uint32_t end;
+  uint32_t found = 0u;
+
+  if (m == NULL || m->plat.dirty_map == NULL || size == 0u || paddr < m->plat.dram_base) {
+    return 0u;
+  }
+  off = paddr - m->plat.dram_base;
+  if (off >= m->plat.dram_size) {
+    return 0u;
+  }
+  if (size > m->plat.dram_size - off) {
+    size = m->plat.dram_size - off;
+  }
+
+  page = off >> DIRTY_PAGE_SHIFT;
+  end = (uint32_t)(((uint64_t)off + size - 1u) >> DIRTY_PAGE_SHIFT) + 1u;
+
+  while (page < end && (page & 7u) != 0u) {
+    found += rv32emu_dirty_scan_byte(m, page++, clear, fn, opaque);
+  }
+  for (; page + 8u <= end; page += 8u) {
+    uint64_t *w = (uint64_t *)(void *)&m->plat.dirty_map[page];
+    uint64_t bits = __atomic_load_n(w, __ATOMIC_RELAXED);
+
+    if (bits == 0u) {
+      continue;
+    }
+    if (clear) {
+      bits = __atomic_exchange_n(w, 0u, __ATOMIC_ACQ_REL);
+    }
+    /* Marked bytes hold exactly 1, so each set bit is one dirty page. */
+    while (bits != 0u) {
+      if (fn != NULL) {
+        uint32_t lane = (uint32_t)__builtin_ctzll(bits) >> 3;
+
+        fn(opaque, m->plat.dram_base + ((page + lane) << DIRTY_PAGE_SHIFT));
+      }
+      bits &= bits - 1u;
+      found++;
+    }
+  }
+  while (page < end) {
+    found += rv32emu_dirty_scan_byte(m, page++, clear, fn, opaque);
+  }
+  return found;
+}
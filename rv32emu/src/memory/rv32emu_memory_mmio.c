@@ -1,25 +1,30 @@
 #include "rv32emu.h"
 
+#include <string.h>
+
 /*
- * Internal MMIO helpers implemented in rv32emu_mmio_devices.c.
- * Callers hold mmio_lock around read/write helpers.
+ * Internal timer helper implemented in rv32emu_mmio_clint_timer.c.
  */
-bool rv32emu_mmio_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out);
-bool rv32emu_mmio_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data);
-void rv32emu_mmio_step_timer(rv32emu_machine_t *m);
+void rv32emu_mmio_flush_timer(rv32emu_machine_t *m);
 
+/*
+ * Single-threaded DRAM access path: plain host loads/stores (memcpy keeps
+ * unaligned guest addresses legal on the host and folds to one mov).
+ */
 static bool rv32emu_read_u32_le(const uint8_t *p, int len, uint32_t *out) {
   if (len == 1) {
     *out = p[0];
     return true;
   }
   if (len == 2) {
-    *out = (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+    uint16_t v16;
+
+    memcpy(&v16, p, sizeof(v16));
+    *out = v16;
     return true;
   }
   if (len == 4) {
-    *out = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
-           ((uint32_t)p[3] << 24);
+    memcpy(out, p, sizeof(*out));
     return true;
   }
   return false;
@@ -31,15 +36,13 @@ static bool rv32emu_write_u32_le(uint8_t *p, int len, uint32_t data) {
     return true;
   }
   if (len == 2) {
-    p[0] = (uint8_t)data;
-    p[1] = (uint8_t)(data >> 8);
+    uint16_t v16 = (uint16_t)data;
+
+    memcpy(p, &v16, sizeof(v16));
     return true;
   }
   if (len == 4) {
-    p[0] = (uint8_t)data;
-    p[1] = (uint8_t)(data >> 8);
-    p[2] = (uint8_t)(data >> 16);
-    p[3] = (uint8_t)(data >> 24);
+    memcpy(p, &data, sizeof(data));
     return true;
   }
   return false;
@@ -136,11 +139,30 @@ static inline void rv32emu_dram_atomic_stat_inc(rv32emu_machine_t *m,
 }
 
 void rv32emu_step_timer(rv32emu_machine_t *m) {
-  rv32emu_mmio_step_timer(m);
+  rv32emu_advance_timer(m, 1u);
+}
+
+/*
+ * Retired ticks collect in the hart's timer_batch_ticks and reach the shared
+ * plat.mtime only once the batch is full or the next timer deadline is due,
+ * so harts stop bouncing the mtime line on every instruction.
+ */
+void rv32emu_advance_timer(rv32emu_machine_t *m, uint32_t ticks) {
+  rv32emu_cpu_t *cpu;
+
+  if (m == NULL) {
+    return;
+  }
+
+  cpu = RV32EMU_CPU(m);
+  cpu->timer_batch_ticks += ticks;
+  if (cpu->timer_batch_ticks >= cpu->timer_batch_limit) {
+    rv32emu_mmio_flush_timer(m);
+  }
 }
 
 void rv32emu_flush_timer(rv32emu_machine_t *m) {
-  (void)m;
+  rv32emu_mmio_flush_timer(m);
 }
 
 uint8_t *rv32emu_dram_ptr(rv32emu_machine_t *m, uint32_t paddr, size_t len) {
@@ -158,7 +180,22 @@ uint8_t *rv32emu_dram_ptr(rv32emu_machine_t *m, uint32_t paddr, size_t len) {
   return m->plat.dram + off;
 }
 
+/*
+ * RAM regions resolve to a host pointer; the access must stay inside the
+ * region. Returns NULL for device regions and out-of-range accesses.
+ */
+static inline uint8_t *rv32emu_phys_ram_ptr(const rv32emu_phys_region_t *region, uint32_t paddr,
+                                            int len) {
+  uint32_t off = paddr - region->base;
+
+  if ((uint64_t)off + (uint64_t)len > (uint64_t)region->size) {
+    return NULL;
+  }
+  return region->host + off;
+}
+
 bool rv32emu_phys_read(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out) {
+  const rv32emu_phys_region_t *region;
   uint8_t *ptr;
   bool ok;
 
@@ -166,35 +203,45 @@ bool rv32emu_phys_read(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *
     return false;
   }
 
-  ptr = rv32emu_dram_ptr(m, paddr, (size_t)len);
-  if (ptr != NULL) {
-    if (m->threaded_exec_active) {
-      if (len == 4 && (paddr & 3u) == 0u) {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_aligned32);
-      } else if (len == 2 && (paddr & 1u) == 0u) {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_aligned16);
-      } else {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_bytepath);
+  ptr = rv32emu_phys_flat_ptr(m, paddr, (uint32_t)len);
+  if (ptr == NULL) {
+    region = rv32emu_phys_lookup(m, paddr);
+    if (region == NULL) {
+      return false;
+    }
+    if (region->host == NULL) {
+      if (region->lock == NULL) {
+        return region->read(m, region->opaque, paddr, len, out);
+      }
+      if (!rv32emu_plat_lock(m, region->lock)) {
+        return false;
       }
-      return rv32emu_read_u32_le_atomic(ptr, paddr, len, out);
+      ok = region->read(m, region->opaque, paddr, len, out);
+      rv32emu_plat_unlock(region->lock);
+      return ok;
     }
-    if (pthread_mutex_lock(&m->plat.dram_lock) != 0) {
+    ptr = rv32emu_phys_ram_ptr(region, paddr, len);
+    if (ptr == NULL) {
       return false;
     }
-    ok = rv32emu_read_u32_le(ptr, len, out);
-    (void)pthread_mutex_unlock(&m->plat.dram_lock);
-    return ok;
   }
 
-  if (pthread_mutex_lock(&m->plat.mmio_lock) != 0) {
-    return false;
+  if (m->threaded_exec_active) {
+    if (len == 4 && (paddr & 3u) == 0u) {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_aligned32);
+    } else if (len == 2 && (paddr & 1u) == 0u) {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_aligned16);
+    } else {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_read_bytepath);
+    }
+    return rv32emu_read_u32_le_atomic(ptr, paddr, len, out);
   }
-  ok = rv32emu_mmio_read_locked(m, paddr, len, out);
-  (void)pthread_mutex_unlock(&m->plat.mmio_lock);
-  return ok;
+  /* Only one host thread touches guest memory outside rv32emu_run_threaded. */
+  return rv32emu_read_u32_le(ptr, len, out);
 }
 
 bool rv32emu_phys_write(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data) {
+  const rv32emu_phys_region_t *region;
   uint8_t *ptr;
   bool ok;
 
@@ -202,30 +249,43 @@ bool rv32emu_phys_write(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t
     return false;
   }
 
-  ptr = rv32emu_dram_ptr(m, paddr, (size_t)len);
-  if (ptr != NULL) {
-    if (m->threaded_exec_active) {
-      if (len == 4 && (paddr & 3u) == 0u) {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_aligned32);
-      } else if (len == 2 && (paddr & 1u) == 0u) {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_aligned16);
-      } else {
-        rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_bytepath);
+  ptr = rv32emu_phys_flat_ptr(m, paddr, (uint32_t)len);
+  if (ptr == NULL) {
+    region = rv32emu_phys_lookup(m, paddr);
+    if (region == NULL) {
+      return false;
+    }
+    if (region->host == NULL) {
+      if (region->lock == NULL) {
+        return region->write(m, region->opaque, paddr, len, data);
       }
-      return rv32emu_write_u32_le_atomic(ptr, paddr, len, data);
+      if (!rv32emu_plat_lock(m, region->lock)) {
+        return false;
+      }
+      ok = region->write(m, region->opaque, paddr, len, data);
+      rv32emu_plat_unlock(region->lock);
+      return ok;
     }
-    if (pthread_mutex_lock(&m->plat.dram_lock) != 0) {
+    ptr = rv32emu_phys_ram_ptr(region, paddr, len);
+    if (ptr == NULL) {
       return false;
     }
-    ok = rv32emu_write_u32_le(ptr, len, data);
-    (void)pthread_mutex_unlock(&m->plat.dram_lock);
-    return ok;
   }
 
-  if (pthread_mutex_lock(&m->plat.mmio_lock) != 0) {
-    return false;
+  if (m->threaded_exec_active) {
+    if (len == 4 && (paddr & 3u) == 0u) {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_aligned32);
+    } else if (len == 2 && (paddr & 1u) == 0u) {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_aligned16);
+    } else {
+      rv32emu_dram_atomic_stat_inc(m, &m->plat.dram_atomic_write_bytepath);
+    }
+    ok = rv32emu_write_u32_le_atomic(ptr, paddr, len, data);
+  } else {
+    ok = rv32emu_write_u32_le(ptr, len, data);
+  }
+  if (ok) {
+    rv32emu_note_dram_write(m, paddr, (uint32_t)len);
   }
-  ok = rv32emu_mmio_write_locked(m, paddr, len, data);
-  (void)pthread_mutex_unlock(&m->plat.mmio_lock);
   return ok;
 }
@@ -1,9 +1,12 @@
 #include "rv32emu.h"
 
+#include <time.h>
+
 #define CLINT_MSIP_BASE 0x0000u
 #define CLINT_MTIMECMP_BASE 0x4000u
 #define CLINT_MTIME 0xbff8u
 
+/* Caller holds plat.clint[hartid].lock. */
 static void rv32emu_sync_timer_irq_for_hart(rv32emu_machine_t *m, uint32_t hartid) {
   rv32emu_cpu_t *cpu;
   bool expired;
@@ -19,7 +22,7 @@ static void rv32emu_sync_timer_irq_for_hart(rv32emu_machine_t *m, uint32_t harti
   }
 
   mtime = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
-  expired = mtime >= m->plat.clint_mtimecmp[hartid];
+  expired = mtime >= rv32emu_clint_mtimecmp(m, hartid);
   if (m->opts.enable_sbi_shim) {
     if (expired) {
       rv32emu_cpu_mip_set_bits(cpu, MIP_STIP);
@@ -45,16 +48,22 @@ static void rv32emu_sync_all_timer_irqs(rv32emu_machine_t *m) {
   }
 
   for (hart = 0u; hart < m->hart_count; hart++) {
+    if (!rv32emu_plat_lock(m, &m->plat.clint[hart].lock)) {
+      continue;
+    }
     rv32emu_sync_timer_irq_for_hart(m, hart);
+    rv32emu_plat_unlock(&m->plat.clint[hart].lock);
   }
   rv32emu_timer_refresh_deadline(m);
 }
 
-bool rv32emu_mmio_clint_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out) {
+bool rv32emu_mmio_clint_read(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                             uint32_t *out) {
   uint32_t off = paddr - RV32EMU_CLINT_BASE;
   uint32_t rel;
   uint32_t hart;
 
+  (void)opaque;
   if (off >= RV32EMU_CLINT_SIZE) {
     return false;
   }
@@ -68,7 +77,7 @@ bool rv32emu_mmio_clint_read_locked(rv32emu_machine_t *m, uint32_t paddr, int le
       return false;
     }
     hart = (off - CLINT_MSIP_BASE) / 4u;
-    *out = m->plat.clint_msip[hart];
+    *out = atomic_load_explicit(&m->plat.clint[hart].msip, memory_order_relaxed);
     return true;
   }
 
@@ -79,18 +88,20 @@ bool rv32emu_mmio_clint_read_locked(rv32emu_machine_t *m, uint32_t paddr, int le
     }
     hart = rel / 8u;
     if ((rel & 0x4u) == 0u) {
-      *out = (uint32_t)(m->plat.clint_mtimecmp[hart] & 0xffffffffu);
+      *out = (uint32_t)(rv32emu_clint_mtimecmp(m, hart) & 0xffffffffu);
     } else {
-      *out = (uint32_t)(m->plat.clint_mtimecmp[hart] >> 32);
+      *out = (uint32_t)(rv32emu_clint_mtimecmp(m, hart) >> 32);
     }
     return true;
   }
 
   switch (off) {
   case CLINT_MTIME:
+    rv32emu_flush_timer(m);
     *out = (uint32_t)(atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) & 0xffffffffu);
     return true;
   case CLINT_MTIME + 4:
+    rv32emu_flush_timer(m);
     *out = (uint32_t)(atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >> 32);
     return true;
   default:
@@ -99,11 +110,14 @@ bool rv32emu_mmio_clint_read_locked(rv32emu_machine_t *m, uint32_t paddr, int le
   }
 }
 
-bool rv32emu_mmio_clint_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data) {
+bool rv32emu_mmio_clint_write(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                              uint32_t data) {
   uint32_t off = paddr - RV32EMU_CLINT_BASE;
   uint32_t rel;
   uint32_t hart;
+  uint64_t cmp;
 
+  (void)opaque;
   if (off >= RV32EMU_CLINT_SIZE) {
     return false;
   }
@@ -120,19 +134,22 @@ bool rv32emu_mmio_clint_write_locked(rv32emu_machine_t *m, uint32_t paddr, int l
     }
 
     hart = (off - CLINT_MSIP_BASE) / 4u;
-    m->plat.clint_msip[hart] = data & 1u;
+    if (!rv32emu_plat_lock(m, &m->plat.clint[hart].lock)) {
+      return false;
+    }
+    atomic_store_explicit(&m->plat.clint[hart].msip, data & 1u, memory_order_relaxed);
     cpu = rv32emu_hart_cpu(m, hart);
     if (cpu != NULL) {
-      if (m->plat.clint_msip[hart] != 0u &&
-          !atomic_load_explicit(&cpu->running, memory_order_acquire)) {
+      if ((data & 1u) != 0u && !atomic_load_explicit(&cpu->running, memory_order_acquire)) {
         atomic_store_explicit(&cpu->running, true, memory_order_release);
       }
-      if (m->plat.clint_msip[hart] != 0u) {
+      if ((data & 1u) != 0u) {
         rv32emu_cpu_mip_set_bits(cpu, MIP_MSIP);
       } else {
         rv32emu_cpu_mip_clear_bits(cpu, MIP_MSIP);
       }
     }
+    rv32emu_plat_unlock(&m->plat.clint[hart].lock);
     return true;
   }
 
@@ -143,18 +160,27 @@ bool rv32emu_mmio_clint_write_locked(rv32emu_machine_t *m, uint32_t paddr, int l
     }
 
     hart = rel / 8u;
+    rv32emu_flush_timer(m);
+    if (!rv32emu_plat_lock(m, &m->plat.clint[hart].lock)) {
+      return false;
+    }
+    cmp = rv32emu_clint_mtimecmp(m, hart);
     if ((rel & 0x4u) == 0u) {
-      m->plat.clint_mtimecmp[hart] =
-          (m->plat.clint_mtimecmp[hart] & 0xffffffff00000000ull) | (uint64_t)data;
+      cmp = (cmp & 0xffffffff00000000ull) | (uint64_t)data;
     } else {
-      m->plat.clint_mtimecmp[hart] =
-          (m->plat.clint_mtimecmp[hart] & 0x00000000ffffffffull) | ((uint64_t)data << 32);
+      cmp = (cmp & 0x00000000ffffffffull) | ((uint64_t)data << 32);
     }
+    atomic_store(&m->plat.clint[hart].mtimecmp, cmp);
     rv32emu_sync_timer_irq_for_hart(m, hart);
+    rv32emu_plat_unlock(&m->plat.clint[hart].lock);
     rv32emu_timer_refresh_deadline(m);
+    rv32emu_flush_timer(m); /* re-arm the batch against the new deadline */
     return true;
   }
 
+  if (off == CLINT_MTIME || off == CLINT_MTIME + 4) {
+    rv32emu_flush_timer(m); /* ticks retired before the write land before it */
+  }
   switch (off) {
   case CLINT_MTIME: {
     uint64_t old_mtime;
@@ -180,7 +206,9 @@ bool rv32emu_mmio_clint_write_locked(rv32emu_machine_t *m, uint32_t paddr, int l
     return true;
   }
 
+  rv32emu_timer_rebase(m);
   rv32emu_sync_all_timer_irqs(m);
+  rv32emu_flush_timer(m);
   return true;
 }
 
@@ -196,24 +224,181 @@ static void rv32emu_timer_sync_if_due(rv32emu_machine_t *m, uint64_t mtime) {
     return;
   }
 
-  if (pthread_mutex_lock(&m->plat.mmio_lock) != 0) {
+  /* Harts racing past the same deadline each resync; per-hart locks keep it idempotent. */
+  rv32emu_sync_all_timer_irqs(m);
+}
+
+static uint64_t rv32emu_host_ticks(const rv32emu_machine_t *m) {
+  struct timespec ts;
+  uint64_t hz = m->opts.timebase_hz;
+
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * hz + (uint64_t)ts.tv_nsec * hz / 1000000000u;
+}
+
+/* Host mode: make the host clock continue from the current plat.mtime. */
+void rv32emu_timer_rebase(rv32emu_machine_t *m) {
+  if (m == NULL || m->opts.mtime_source != RV32EMU_MTIME_HOST) {
     return;
   }
+  atomic_store_explicit(&m->plat.mtime_offset,
+                        atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) -
+                            rv32emu_host_ticks(m),
+                        memory_order_relaxed);
+}
 
-  if (mtime >= atomic_load_explicit(&m->plat.next_timer_deadline, memory_order_relaxed)) {
-    rv32emu_sync_all_timer_irqs(m);
+/*
+ * Host mode: sample the clock into plat.mtime. Racing harts only move it
+ * forward, so the published value stays monotonic.
+ */
+static uint64_t rv32emu_host_mtime_publish(rv32emu_machine_t *m) {
+  uint64_t now = rv32emu_host_ticks(m) +
+                 atomic_load_explicit(&m->plat.mtime_offset, memory_order_relaxed);
+  uint64_t old = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
+
+  while (old < now) {
+    if (atomic_compare_exchange_weak_explicit(&m->plat.mtime, &old, now, memory_order_relaxed,
+                                              memory_order_relaxed)) {
+      return now;
+    }
   }
+  return old;
+}
 
-  (void)pthread_mutex_unlock(&m->plat.mmio_lock);
+/*
+ * Host mode: nanoseconds until next_timer_deadline, clamped to max_ns. A
+ * deadline already behind mtime raised its interrupt when it passed, so it
+ * is no reason to wake again. Instret mode has no host-time deadline.
+ */
+uint64_t rv32emu_timer_idle_ns(rv32emu_machine_t *m, uint64_t max_ns) {
+  uint64_t mtime;
+  uint64_t deadline;
+  uint64_t ticks;
+
+  if (m == NULL || m->opts.mtime_source != RV32EMU_MTIME_HOST) {
+    return max_ns;
+  }
+  mtime = rv32emu_host_mtime_publish(m);
+  deadline = atomic_load_explicit(&m->plat.next_timer_deadline, memory_order_relaxed);
+  if (deadline <= mtime) {
+    return max_ns;
+  }
+  ticks = deadline - mtime;
+  if (ticks >= max_ns / 1000u * m->opts.timebase_hz / 1000000u + 1u) {
+    return max_ns;
+  }
+  return ticks * 1000000000u / m->opts.timebase_hz;
 }
 
-void rv32emu_mmio_step_timer(rv32emu_machine_t *m) {
+/*
+ * Instret mode: move mtime forward by at most max_ticks, stopping at the
+ * nearest comparator still ahead of it and raising the interrupts that fall
+ * due there. Returns the ticks skipped; 0 when nothing moved, or when
+ * need_deadline is set and no comparator is ahead.
+ */
+static uint64_t rv32emu_timer_jump(rv32emu_machine_t *m, uint64_t max_ticks, bool need_deadline) {
+  uint64_t deadline = UINT64_MAX;
+  uint64_t old;
+
+  if (m == NULL || m->opts.mtime_source != RV32EMU_MTIME_INSTRET || max_ticks == 0u) {
+    return 0u;
+  }
+  rv32emu_flush_timer(m);
+  old = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
+  for (uint32_t hart = 0u; hart < m->hart_count; hart++) {
+    uint64_t cmp = rv32emu_clint_mtimecmp(m, hart);
+
+    if (cmp > old && cmp < deadline) {
+      deadline = cmp;
+    }
+  }
+  if (deadline == UINT64_MAX && need_deadline) {
+    return 0u;
+  }
+  while (old < deadline) {
+    uint64_t target = deadline - old <= max_ticks ? deadline : old + max_ticks;
+
+    if (atomic_compare_exchange_weak_explicit(&m->plat.mtime, &old, target, memory_order_relaxed,
+                                              memory_order_relaxed)) {
+      if (target == deadline) {
+        rv32emu_sync_all_timer_irqs(m);
+      }
+      rv32emu_flush_timer(m); /* re-arm the batch limit against the new mtime */
+      return target - old;
+    }
+  }
+  return 0u;
+}
+
+/*
+ * Instret mode with every running hart idle in wfi: nothing retires, so
+ * jump mtime straight to the nearest comparator still ahead of it.
+ * Comparators already passed are skipped (their interrupt is raised but
+ * masked). Returns false if no comparator is ahead.
+ */
+bool rv32emu_timer_fast_forward(rv32emu_machine_t *m) {
+  uint64_t skipped = rv32emu_timer_jump(m, UINT64_MAX, true);
+
+  if (skipped == 0u) {
+    return false;
+  }
+  atomic_fetch_add_explicit(&m->plat.idle_warps, 1u, memory_order_relaxed);
+  atomic_fetch_add_explicit(&m->plat.idle_warp_ticks, skipped, memory_order_relaxed);
+  return true;
+}
+
+/*
+ * Instret mode, current hart spinning on the time: let mtime run ahead by up
+ * to ticks, never past the next deadline. Returns the ticks skipped.
+ */
+uint64_t rv32emu_timer_spin_warp(rv32emu_machine_t *m, uint64_t ticks) {
+  uint64_t skipped = rv32emu_timer_jump(m, ticks, false);
+
+  if (skipped != 0u) {
+    atomic_fetch_add_explicit(&m->plat.spin_warps, 1u, memory_order_relaxed);
+    atomic_fetch_add_explicit(&m->plat.spin_warp_ticks, skipped, memory_order_relaxed);
+  }
+  return skipped;
+}
+
+/*
+ * Publish the current hart's batched ticks and re-arm its batch limit: the
+ * configured cap, shortened so the batch ends exactly at next_timer_deadline.
+ * A deadline lowered by another hart is seen at this hart's next flush, so
+ * cross-hart timer latency is bounded by opts.timer_batch.
+ */
+void rv32emu_mmio_flush_timer(rv32emu_machine_t *m) {
+  rv32emu_cpu_t *cpu;
   uint64_t mtime;
+  uint64_t deadline;
+  uint32_t limit;
 
-  if (m == NULL) {
+  if (m == NULL || (cpu = RV32EMU_CPU(m)) == NULL) {
     return;
   }
 
-  mtime = atomic_fetch_add_explicit(&m->plat.mtime, 1u, memory_order_relaxed) + 1u;
+  if (m->opts.mtime_source == RV32EMU_MTIME_HOST) {
+    /* Retired ticks only pace how often the host clock is polled. */
+    cpu->timer_batch_ticks = 0u;
+    cpu->timer_batch_limit = RV32EMU_HOST_CLOCK_POLL_INSNS;
+    rv32emu_timer_sync_if_due(m, rv32emu_host_mtime_publish(m));
+    return;
+  }
+
+  if (cpu->timer_batch_ticks != 0u) {
+    mtime = atomic_fetch_add_explicit(&m->plat.mtime, cpu->timer_batch_ticks,
+                                      memory_order_relaxed) +
+            cpu->timer_batch_ticks;
+    cpu->timer_batch_ticks = 0u;
+  } else {
+    mtime = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
+  }
   rv32emu_timer_sync_if_due(m, mtime);
+
+  limit = m->opts.timer_batch != 0u ? m->opts.timer_batch : 1u;
+  deadline = atomic_load_explicit(&m->plat.next_timer_deadline, memory_order_relaxed);
+  if (deadline > mtime && deadline - mtime < limit) {
+    limit = (uint32_t)(deadline - mtime);
+  }
+  cpu->timer_batch_limit = limit;
 }
@@ -9,19 +9,26 @@
 #define VIRTIO_MMIO_VENDOR_ID 0x00cu
 #define VIRTIO_MMIO_STATUS 0x070u
 
-bool rv32emu_mmio_uart_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out);
-bool rv32emu_mmio_uart_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data);
-bool rv32emu_mmio_clint_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out);
-bool rv32emu_mmio_clint_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data);
-bool rv32emu_mmio_plic_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out);
-bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data);
-
-static bool rv32emu_handle_virtio_mmio_read(rv32emu_machine_t *m, uint32_t paddr, int len,
-                                            uint32_t *out) {
+bool rv32emu_mmio_uart_read_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                   uint32_t *out);
+bool rv32emu_mmio_uart_write_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                    uint32_t data);
+bool rv32emu_mmio_clint_read(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                             uint32_t *out);
+bool rv32emu_mmio_clint_write(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                              uint32_t data);
+bool rv32emu_mmio_plic_read_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                   uint32_t *out);
+bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                                    uint32_t data);
+
+static bool rv32emu_handle_virtio_mmio_read(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                            int len, uint32_t *out) {
   uint32_t off = paddr - VIRTIO_MMIO_BASE;
   uint32_t slot_off;
 
   (void)m;
+  (void)opaque;
 
   if (off >= VIRTIO_MMIO_SIZE || len != 4) {
     return false;
@@ -50,11 +57,12 @@ static bool rv32emu_handle_virtio_mmio_read(rv32emu_machine_t *m, uint32_t paddr
   }
 }
 
-static bool rv32emu_handle_virtio_mmio_write(rv32emu_machine_t *m, uint32_t paddr, int len,
-                                             uint32_t data) {
+static bool rv32emu_handle_virtio_mmio_write(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                             int len, uint32_t data) {
   uint32_t off = paddr - VIRTIO_MMIO_BASE;
 
   (void)m;
+  (void)opaque;
   (void)data;
 
   if (off >= VIRTIO_MMIO_SIZE || len != 4) {
@@ -64,50 +72,26 @@ static bool rv32emu_handle_virtio_mmio_write(rv32emu_machine_t *m, uint32_t padd
   return true;
 }
 
-bool rv32emu_mmio_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out) {
-  if (m == NULL || out == NULL) {
-    return false;
-  }
-
-  if (paddr >= RV32EMU_UART_BASE && paddr < RV32EMU_UART_BASE + RV32EMU_UART_SIZE) {
-    return rv32emu_mmio_uart_read_locked(m, paddr, len, out);
-  }
-
-  if (paddr >= RV32EMU_CLINT_BASE && paddr < RV32EMU_CLINT_BASE + RV32EMU_CLINT_SIZE) {
-    return rv32emu_mmio_clint_read_locked(m, paddr, len, out);
-  }
-
-  if (paddr >= RV32EMU_PLIC_BASE && paddr < RV32EMU_PLIC_BASE + RV32EMU_PLIC_SIZE) {
-    return rv32emu_mmio_plic_read_locked(m, paddr, len, out);
-  }
-
-  if (paddr >= VIRTIO_MMIO_BASE && paddr < VIRTIO_MMIO_BASE + VIRTIO_MMIO_SIZE) {
-    return rv32emu_handle_virtio_mmio_read(m, paddr, len, out);
-  }
-
-  return false;
-}
-
-bool rv32emu_mmio_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data) {
+/*
+ * Register the built-in device set in the physical map. Dispatch is then a
+ * table lookup in phys_read/phys_write instead of an address if-chain here.
+ * UART and PLIC each serialize on their own lock; CLINT keeps per-hart state
+ * and virtio stubs are stateless, so neither takes a region lock.
+ */
+bool rv32emu_mmio_register_devices(rv32emu_machine_t *m) {
   if (m == NULL) {
     return false;
   }
 
-  if (paddr >= RV32EMU_UART_BASE && paddr < RV32EMU_UART_BASE + RV32EMU_UART_SIZE) {
-    return rv32emu_mmio_uart_write_locked(m, paddr, len, data);
-  }
-
-  if (paddr >= RV32EMU_CLINT_BASE && paddr < RV32EMU_CLINT_BASE + RV32EMU_CLINT_SIZE) {
-    return rv32emu_mmio_clint_write_locked(m, paddr, len, data);
-  }
-
-  if (paddr >= RV32EMU_PLIC_BASE && paddr < RV32EMU_PLIC_BASE + RV32EMU_PLIC_SIZE) {
-    return rv32emu_mmio_plic_write_locked(m, paddr, len, data);
-  }
-
-  if (paddr >= VIRTIO_MMIO_BASE && paddr < VIRTIO_MMIO_BASE + VIRTIO_MMIO_SIZE) {
-    return rv32emu_handle_virtio_mmio_write(m, paddr, len, data);
-  }
-
-  return false;
+  return rv32emu_phys_map_device(m, "uart", RV32EMU_UART_BASE, RV32EMU_UART_SIZE,
+                                 rv32emu_mmio_uart_read_locked, rv32emu_mmio_uart_write_locked,
+                                 NULL, &m->plat.uart_lock) &&
+         rv32emu_phys_map_device(m, "clint", RV32EMU_CLINT_BASE, RV32EMU_CLINT_SIZE,
+                                 rv32emu_mmio_clint_read, rv32emu_mmio_clint_write, NULL, NULL) &&
+         rv32emu_phys_map_device(m, "plic", RV32EMU_PLIC_BASE, RV32EMU_PLIC_SIZE,
+                                 rv32emu_mmio_plic_read_locked, rv32emu_mmio_plic_write_locked,
+                                 NULL, &m->plat.plic_lock) &&
+         rv32emu_phys_map_device(m, "virtio", VIRTIO_MMIO_BASE, VIRTIO_MMIO_SIZE,
+                                 rv32emu_handle_virtio_mmio_read,
+                                 rv32emu_handle_virtio_mmio_write, NULL, NULL);
 }
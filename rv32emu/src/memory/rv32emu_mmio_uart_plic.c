@@ -82,10 +82,11 @@ static bool rv32emu_uart_tx_irq_should_assert(const rv32emu_machine_t *m) {
          (m->plat.uart_regs[UART_REG_IER] & UART_IER_THRI) != 0u;
 }
 
-static void rv32emu_uart_sync_irq(rv32emu_machine_t *m) {
+/* Caller holds plat.plic_lock. */
+static void rv32emu_plic_sample_uart_locked(rv32emu_machine_t *m) {
   uint32_t uart_bit = 1u << UART_PLIC_IRQ;
 
-  if (rv32emu_uart_irq_should_assert(m) || rv32emu_uart_tx_irq_should_assert(m)) {
+  if (atomic_load_explicit(&m->plat.uart_irq_level, memory_order_acquire)) {
     m->plat.plic_pending |= uart_bit;
   } else {
     m->plat.plic_pending &= ~uart_bit;
@@ -93,6 +94,22 @@ static void rv32emu_uart_sync_irq(rv32emu_machine_t *m) {
   rv32emu_update_plic_irq_lines(m);
 }
 
+/*
+ * Caller holds plat.uart_lock. The UART publishes its interrupt line as an
+ * atomic level so the PLIC can resample it under plic_lock alone; the lock
+ * order is always uart_lock -> plic_lock.
+ */
+static void rv32emu_uart_sync_irq(rv32emu_machine_t *m) {
+  bool level = rv32emu_uart_irq_should_assert(m) || rv32emu_uart_tx_irq_should_assert(m);
+
+  atomic_store_explicit(&m->plat.uart_irq_level, level, memory_order_release);
+  if (!rv32emu_plat_lock(m, &m->plat.plic_lock)) {
+    return;
+  }
+  rv32emu_plic_sample_uart_locked(m);
+  rv32emu_plat_unlock(&m->plat.plic_lock);
+}
+
 static bool rv32emu_uart_pop_rx(rv32emu_machine_t *m, uint8_t *out) {
   if (m->plat.uart_rx_count == 0u) {
     return false;
@@ -105,15 +122,21 @@ static bool rv32emu_uart_pop_rx(rv32emu_machine_t *m, uint8_t *out) {
 }
 
 bool rv32emu_uart_push_rx(rv32emu_machine_t *m, uint8_t data) {
-  if (m == NULL || m->plat.uart_rx_count >= RV32EMU_UART_RX_FIFO_SIZE) {
+  bool ok = false;
+
+  if (m == NULL || !rv32emu_plat_lock(m, &m->plat.uart_lock)) {
     return false;
   }
 
-  m->plat.uart_rx_fifo[m->plat.uart_rx_tail] = data;
-  m->plat.uart_rx_tail = (uint16_t)((m->plat.uart_rx_tail + 1u) % RV32EMU_UART_RX_FIFO_SIZE);
-  m->plat.uart_rx_count++;
-  rv32emu_uart_sync_irq(m);
-  return true;
+  if (m->plat.uart_rx_count < RV32EMU_UART_RX_FIFO_SIZE) {
+    m->plat.uart_rx_fifo[m->plat.uart_rx_tail] = data;
+    m->plat.uart_rx_tail = (uint16_t)((m->plat.uart_rx_tail + 1u) % RV32EMU_UART_RX_FIFO_SIZE);
+    m->plat.uart_rx_count++;
+    rv32emu_uart_sync_irq(m);
+    ok = true;
+  }
+  rv32emu_plat_unlock(&m->plat.uart_lock);
+  return ok;
 }
 
 static uint32_t rv32emu_plic_find_claimable(uint32_t pending, uint32_t enabled) {
@@ -152,11 +175,13 @@ static uint32_t rv32emu_plic_claim(rv32emu_machine_t *m, uint32_t context) {
   return m->plat.plic_claim[context];
 }
 
-bool rv32emu_mmio_uart_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out) {
+bool rv32emu_mmio_uart_read_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                   int len, uint32_t *out) {
   uint32_t off = paddr - RV32EMU_UART_BASE;
   uint8_t idx;
   uint32_t value = 0;
 
+  (void)opaque;
   if (off >= RV32EMU_UART_SIZE) {
     return false;
   }
@@ -205,11 +230,13 @@ bool rv32emu_mmio_uart_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len
   return true;
 }
 
-bool rv32emu_mmio_uart_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data) {
+bool rv32emu_mmio_uart_write_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                    int len, uint32_t data) {
   uint32_t off = paddr - RV32EMU_UART_BASE;
   uint8_t idx;
   uint8_t ch = (uint8_t)data;
 
+  (void)opaque;
   if (off >= RV32EMU_UART_SIZE) {
     return false;
   }
@@ -255,13 +282,15 @@ bool rv32emu_mmio_uart_write_locked(rv32emu_machine_t *m, uint32_t paddr, int le
   return true;
 }
 
-bool rv32emu_mmio_plic_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t *out) {
+bool rv32emu_mmio_plic_read_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                   int len, uint32_t *out) {
   uint32_t off = paddr - RV32EMU_PLIC_BASE;
   uint32_t context_count;
   uint32_t rel;
   uint32_t context;
   uint32_t context_off;
 
+  (void)opaque;
   if (off >= RV32EMU_PLIC_SIZE) {
     return false;
   }
@@ -309,13 +338,15 @@ bool rv32emu_mmio_plic_read_locked(rv32emu_machine_t *m, uint32_t paddr, int len
   return true;
 }
 
-bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, uint32_t paddr, int len, uint32_t data) {
+bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, void *opaque, uint32_t paddr,
+                                    int len, uint32_t data) {
   uint32_t off = paddr - RV32EMU_PLIC_BASE;
   uint32_t context_count;
   uint32_t rel;
   uint32_t context;
   uint32_t context_off;
 
+  (void)opaque;
   if (off >= RV32EMU_PLIC_SIZE) {
     return false;
   }
@@ -329,7 +360,7 @@ bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, uint32_t paddr, int le
   switch (off) {
   case PLIC_PENDING:
     m->plat.plic_pending = data;
-    rv32emu_uart_sync_irq(m);
+    rv32emu_plic_sample_uart_locked(m);
     return true;
   default:
     break;
@@ -354,7 +385,7 @@ bool rv32emu_mmio_plic_write_locked(rv32emu_machine_t *m, uint32_t paddr, int le
     if (context_off == PLIC_CONTEXT_CLAIM) {
       if (data == m->plat.plic_claim[context]) {
         m->plat.plic_claim[context] = 0u;
-        rv32emu_uart_sync_irq(m);
+        rv32emu_plic_sample_uart_locked(m);
       } else {
         rv32emu_update_plic_irq_lines(m);
       }
@@ -0,0 +1,131 @@
+#include "rv32emu.h"
+
+#include <stdlib.h>
+
+#define PHYS_PAGE_SHIFT 12u
+
+/*
+ * Physical memory map:
+ * - every RAM/device region is registered once at platform init;
+ * - rv32emu_phys_lookup() resolves any address through at most two array
+ *   loads, so adding devices never lengthens the phys_read/phys_write path.
+ */
+static bool rv32emu_phys_page_mapped(const rv32emu_phys_map_t *map, uint32_t page) {
+  const rv32emu_phys_slot_t *slot = &map->slots[page >> (RV32EMU_PHYS_L1_SHIFT - PHYS_PAGE_SHIFT)];
+
+  if (slot->block != NULL) {
+    return true;
+  }
+  return slot->pages != NULL && slot->pages[page & (RV32EMU_PHYS_L2_ENTRIES - 1u)] != NULL;
+}
+
+static bool rv32emu_phys_map_insert(rv32emu_machine_t *m, const rv32emu_phys_region_t *desc) {
+  rv32emu_phys_map_t *map;
+  rv32emu_phys_region_t *region;
+  uint32_t first_page;
+  uint32_t last_page;
+  uint32_t page;
+
+  if (m == NULL || desc->size == 0u || (desc->base & ((1u << PHYS_PAGE_SHIFT) - 1u)) != 0u ||
+      (uint64_t)desc->base + (uint64_t)desc->size > (1ull << 32)) {
+    return false;
+  }
+
+  map = &m->plat.phys_map;
+  if (map->region_count >= RV32EMU_PHYS_MAX_REGIONS) {
+    return false;
+  }
+
+  first_page = desc->base >> PHYS_PAGE_SHIFT;
+  last_page = (uint32_t)(((uint64_t)desc->base + desc->size - 1u) >> PHYS_PAGE_SHIFT);
+  for (page = first_page; page <= last_page; page++) {
+    if (rv32emu_phys_page_mapped(map, page)) {
+      return false;
+    }
+  }
+
+  region = &map->regions[map->region_count];
+  *region = *desc;
+
+  page = first_page;
+  while (page <= last_page) {
+    uint32_t slot_index = page >> (RV32EMU_PHYS_L1_SHIFT - PHYS_PAGE_SHIFT);
+    uint32_t slot_pages = RV32EMU_PHYS_L2_ENTRIES;
+    rv32emu_phys_slot_t *slot = &map->slots[slot_index];
+
+    if ((page & (slot_pages - 1u)) == 0u && last_page - page >= slot_pages - 1u &&
+        slot->pages == NULL) {
+      slot->block = region;
+      page += slot_pages;
+      if (page == 0u) {
+        break; /* region ends at the top of the 32-bit space */
+      }
+      continue;
+    }
+
+    if (slot->pages == NULL) {
+      slot->pages = calloc(RV32EMU_PHYS_L2_ENTRIES, sizeof(*slot->pages));
+      if (slot->pages == NULL) {
+        return false;
+      }
+    }
+    slot->pages[page & (slot_pages - 1u)] = region;
+    page++;
+    if (page == 0u) {
+      break;
+    }
+  }
+
+  map->region_count++;
+  return true;
+}
+
+bool rv32emu_phys_map_ram(rv32emu_machine_t *m, const char *name, uint32_t base, uint32_t size,
+                          uint8_t *host) {
+  rv32emu_phys_region_t desc = {
+      .name = name,
+      .base = base,
+      .size = size,
+      .host = host,
+  };
+
+  if (host == NULL) {
+    return false;
+  }
+  return rv32emu_phys_map_insert(m, &desc);
+}
+
+bool rv32emu_phys_map_device(rv32emu_machine_t *m, const char *name, uint32_t base, uint32_t size,
+                             rv32emu_mmio_read_fn read, rv32emu_mmio_write_fn write,
+                             void *opaque, pthread_mutex_t *lock) {
+  rv32emu_phys_region_t desc = {
+      .name = name,
+      .base = base,
+      .size = size,
+      .read = read,
+      .write = write,
+      .opaque = opaque,
+      .lock = lock,
+  };
+
+  if (read == NULL || write == NULL) {
+    return false;
+  }
+  return rv32emu_phys_map_insert(m, &desc);
+}
+
+void rv32emu_phys_map_destroy(rv32emu_machine_t *m) {
+  rv32emu_phys_map_t *map;
+
+  if (m == NULL) {
+    return;
+  }
+
+  map = &m->plat.phys_map;
+  for (uint32_t i = 0u; i < RV32EMU_PHYS_L1_ENTRIES; i++) {
+    free(map->slots[i].pages);
+    map->slots[i].pages = NULL;
+    map->slots[i].block = NULL;
+  }
+  map->region_count = 0u;
+}
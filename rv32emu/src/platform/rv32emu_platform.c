@@ -1,13 +1,165 @@
 #include "rv32emu.h"
 
-#include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define RV32EMU_HUGE_PAGE_SIZE (2u * 1024u * 1024u)
 
 static uint32_t rv32emu_default_misa_value(void) {
   return (1u << 30) | (1u << 0) | (1u << 2) | (1u << 3) | (1u << 5) | (1u << 8) |
          (1u << 12) | (1u << 18) | (1u << 20);
 }
 
+static void *rv32emu_dram_mmap(void *at, size_t size, int flags) {
+  void *mem = mmap(at, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | flags | (at != NULL ? MAP_FIXED : 0), -1, 0);
+
+  return mem == MAP_FAILED ? NULL : mem;
+}
+
+/*
+ * Flat guest-physical window: reserve 4 GiB of inaccessible address space
+ * (aligned for huge pages) so DRAM can be mapped at window + dram_base and
+ * any DRAM paddr is window + paddr. Device and unmapped ranges stay guard
+ * pages, so a stray host pointer faults instead of hitting other memory;
+ * MMIO itself keeps going through the phys_map slow path. Needs a 64-bit
+ * host; elsewhere (or when the reservation fails) DRAM is mapped on its own.
+ */
+static bool rv32emu_phys_window_reserve(rv32emu_platform_t *plat) {
+#if UINTPTR_MAX > 0xffffffffu
+  size_t align = RV32EMU_HUGE_PAGE_SIZE;
+  size_t size = ((size_t)1 << 32) + align;
+  void *mem;
+
+  if ((uint64_t)plat->dram_base + plat->dram_size > ((uint64_t)1 << 32)) {
+    return false;
+  }
+  mem = mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+  plat->phys_window_map = mem;
+  plat->phys_window_map_size = size;
+  plat->phys_window = (uint8_t *)(((uintptr_t)mem + align - 1u) & ~(uintptr_t)(align - 1u));
+  return true;
+#else
+  (void)plat;
+  return false;
+#endif
+}
+
+/*
+ * Shared-memory DRAM: the same pages can later be mapped a second time at
+ * any host address through plat.dram_fd, which private anonymous memory
+ * cannot offer. tmpfs allocates on first touch, like MAP_NORESERVE.
+ */
+static void *rv32emu_dram_memfd_map(rv32emu_platform_t *plat, void *at, size_t size) {
+#ifdef SYS_memfd_create
+  int fd = (int)syscall(SYS_memfd_create, "rv32emu-dram", 0u);
+  void *mem;
+
+  if (fd < 0) {
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)size) != 0) {
+    (void)close(fd);
+    return NULL;
+  }
+  mem = mmap(at, size, PROT_READ | PROT_WRITE, MAP_SHARED | (at != NULL ? MAP_FIXED : 0), fd, 0);
+  if (mem == MAP_FAILED) {
+    (void)close(fd);
+    return NULL;
+  }
+  plat->dram_fd = fd;
+  return mem;
+#else
+  (void)plat;
+  (void)at;
+  (void)size;
+  return NULL;
+#endif
+}
+
+/*
+ * Map guest DRAM lazily: anonymous MAP_NORESERVE memory is zero-filled on
+ * first touch, so RSS and startup cost follow the guest working set instead
+ * of ram_mb. Huge page requests degrade to 4 KiB pages when the host cannot
+ * satisfy them; plat.dram_backing records what was actually used.
+ */
+static bool rv32emu_dram_map(rv32emu_platform_t *plat, rv32emu_dram_backing_t backing) {
+  size_t size = plat->dram_size;
+  void *at = plat->phys_window != NULL ? plat->phys_window + plat->dram_base : NULL;
+  void *mem = NULL;
+
+  if (backing == RV32EMU_DRAM_BACKING_HUGETLB) {
+#ifdef MAP_HUGETLB
+    size_t huge_mask = (size_t)RV32EMU_HUGE_PAGE_SIZE - 1u;
+    size_t huge_size = (size + huge_mask) & ~huge_mask;
+
+    /*
+     * No MAP_NORESERVE here: hugetlb pages come from a preallocated pool, and
+     * an unreserved mapping would SIGBUS on first touch once it runs dry.
+     */
+    mem = rv32emu_dram_mmap(at, huge_size, MAP_HUGETLB);
+    if (mem != NULL) {
+      size = huge_size;
+    }
+#endif
+    if (mem == NULL) {
+      backing = RV32EMU_DRAM_BACKING_ANON;
+    }
+  }
+
+  if (backing == RV32EMU_DRAM_BACKING_MEMFD) {
+    mem = rv32emu_dram_memfd_map(plat, at, size);
+    if (mem == NULL) {
+      backing = RV32EMU_DRAM_BACKING_ANON;
+    }
+  }
+
+  if (mem == NULL) {
+    mem = rv32emu_dram_mmap(at, size, MAP_NORESERVE);
+    if (mem == NULL) {
+      return false;
+    }
+  }
+
+  if (backing == RV32EMU_DRAM_BACKING_THP) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(mem, size, MADV_HUGEPAGE) != 0) {
+      backing = RV32EMU_DRAM_BACKING_ANON;
+    }
+#else
+    backing = RV32EMU_DRAM_BACKING_ANON;
+#endif
+  }
+
+  plat->dram = (uint8_t *)mem;
+  plat->dram_map_size = size;
+  plat->dram_backing = backing;
+  return true;
+}
+
+static void rv32emu_dram_unmap(rv32emu_platform_t *plat) {
+  if (plat->phys_window_map != NULL) {
+    (void)munmap(plat->phys_window_map, plat->phys_window_map_size); /* DRAM lives inside */
+  } else if (plat->dram != NULL) {
+    (void)munmap(plat->dram, plat->dram_map_size);
+  }
+  if (plat->dram_fd >= 0) {
+    (void)close(plat->dram_fd);
+  }
+  plat->dram_fd = -1;
+  plat->dram = NULL;
+  plat->dram_map_size = 0u;
+  plat->phys_window = NULL;
+  plat->phys_window_map = NULL;
+  plat->phys_window_map_size = 0u;
+}
+
 void rv32emu_default_options(rv32emu_options_t *opts) {
   if (opts == NULL) {
     return;
@@ -19,10 +171,52 @@ void rv32emu_default_options(rv32emu_options_t *opts) {
   opts->dtb_load_addr = RV32EMU_DEFAULT_DTB_LOAD;
   opts->initrd_load_addr = RV32EMU_DEFAULT_INITRD_LOAD;
   opts->hart_count = RV32EMU_DEFAULT_HART_COUNT;
+  opts->tlb_entries = RV32EMU_DEFAULT_TLB_ENTRIES;
+  opts->timer_batch = RV32EMU_DEFAULT_TIMER_BATCH;
+  opts->timebase_hz = RV32EMU_DEFAULT_TIMEBASE_HZ;
   opts->max_instructions = RV32EMU_DEFAULT_MAX_INSTR;
   opts->boot_s_mode = true;
 }
 
+static void rv32emu_platform_destroy_locks(rv32emu_platform_t *plat, uint32_t clint_locks) {
+  uint32_t hart;
+
+  for (hart = 0u; hart < clint_locks; hart++) {
+    (void)pthread_mutex_destroy(&plat->clint[hart].lock);
+  }
+  (void)pthread_mutex_destroy(&plat->plic_lock);
+  (void)pthread_mutex_destroy(&plat->uart_lock);
+  (void)pthread_mutex_destroy(&plat->amo_lock);
+}
+
+/*
+ * Device state is locked per device (UART, PLIC) and per hart (CLINT) so
+ * unrelated MMIO traffic from different harts never serializes.
+ */
+static bool rv32emu_platform_init_locks(rv32emu_platform_t *plat) {
+  uint32_t hart;
+
+  if (pthread_mutex_init(&plat->amo_lock, NULL) != 0) {
+    return false;
+  }
+  if (pthread_mutex_init(&plat->uart_lock, NULL) != 0) {
+    (void)pthread_mutex_destroy(&plat->amo_lock);
+    return false;
+  }
+  if (pthread_mutex_init(&plat->plic_lock, NULL) != 0) {
+    (void)pthread_mutex_destroy(&plat->uart_lock);
+    (void)pthread_mutex_destroy(&plat->amo_lock);
+    return false;
+  }
+  for (hart = 0u; hart < RV32EMU_MAX_HARTS; hart++) {
+    if (pthread_mutex_init(&plat->clint[hart].lock, NULL) != 0) {
+      rv32emu_platform_destroy_locks(plat, hart);
+      return false;
+    }
+  }
+  return true;
+}
+
 bool rv32emu_platform_init(rv32emu_machine_t *m, const rv32emu_options_t *opts) {
   rv32emu_options_t local_opts;
   uint32_t hart;
@@ -49,46 +243,66 @@ bool rv32emu_platform_init(rv32emu_machine_t *m, const rv32emu_options_t *opts)
   if (m->opts.hart_count > RV32EMU_MAX_HARTS) {
     return false;
   }
+  if (m->opts.tlb_entries > RV32EMU_TLB_MAX_ENTRIES ||
+      (m->opts.tlb_entries & (m->opts.tlb_entries - 1u)) != 0u) {
+    return false;
+  }
   m->hart_count = m->opts.hart_count;
   rv32emu_set_active_hart(m, 0u);
 
   m->plat.dram_base = RV32EMU_DRAM_BASE;
   m->plat.dram_size = m->opts.ram_mb * 1024u * 1024u;
-  m->plat.dram = calloc(1u, m->plat.dram_size);
-  if (m->plat.dram == NULL) {
+  m->plat.dram_fd = -1;
+  if (m->opts.flat_phys && !rv32emu_phys_window_reserve(&m->plat)) {
+    m->opts.flat_phys = false;
+  }
+  if (!rv32emu_dram_map(&m->plat, m->opts.dram_backing)) {
+    rv32emu_dram_unmap(&m->plat);
     return false;
   }
 
-  if (pthread_mutex_init(&m->plat.dram_lock, NULL) != 0) {
-    free(m->plat.dram);
-    m->plat.dram = NULL;
+  if (!rv32emu_platform_init_locks(&m->plat)) {
+    rv32emu_dram_unmap(&m->plat);
     return false;
   }
-  if (pthread_mutex_init(&m->plat.mmio_lock, NULL) != 0) {
-    (void)pthread_mutex_destroy(&m->plat.dram_lock);
-    free(m->plat.dram);
-    m->plat.dram = NULL;
+  if (!rv32emu_hart_park_init(m)) {
+    rv32emu_platform_destroy_locks(&m->plat, RV32EMU_MAX_HARTS);
+    rv32emu_dram_unmap(&m->plat);
     return false;
   }
-  if (pthread_mutex_init(&m->plat.amo_lock, NULL) != 0) {
-    (void)pthread_mutex_destroy(&m->plat.mmio_lock);
-    (void)pthread_mutex_destroy(&m->plat.dram_lock);
-    free(m->plat.dram);
-    m->plat.dram = NULL;
+  if (!rv32emu_phys_map_ram(m, "dram", m->plat.dram_base, m->plat.dram_size, m->plat.dram) ||
+      !rv32emu_mmio_register_devices(m) || !rv32emu_code_version_init(m) ||
+      (m->opts.dirty_tracking && !rv32emu_dirty_map_init(m))) {
+    rv32emu_platform_destroy(m);
     return false;
   }
 
   m->plat.dram_atomic_stats_enable = false;
   atomic_store_explicit(&m->plat.mtime, 0u, memory_order_relaxed);
+  if (m->opts.timebase_hz == 0u) {
+    m->opts.timebase_hz = RV32EMU_DEFAULT_TIMEBASE_HZ;
+  }
+  rv32emu_timer_rebase(m);
   atomic_store_explicit(&m->plat.dram_atomic_read_aligned32, 0u, memory_order_relaxed);
   atomic_store_explicit(&m->plat.dram_atomic_read_aligned16, 0u, memory_order_relaxed);
   atomic_store_explicit(&m->plat.dram_atomic_read_bytepath, 0u, memory_order_relaxed);
   atomic_store_explicit(&m->plat.dram_atomic_write_aligned32, 0u, memory_order_relaxed);
   atomic_store_explicit(&m->plat.dram_atomic_write_aligned16, 0u, memory_order_relaxed);
   atomic_store_explicit(&m->plat.dram_atomic_write_bytepath, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.tlb_hits, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.tlb_misses, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.pwc_hits, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.idle_warps, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.idle_warp_ticks, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.spin_warps, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.spin_warp_ticks, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.lock_acquires, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.lock_contended, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.lr_live, 0u, memory_order_relaxed);
+  atomic_store_explicit(&m->plat.uart_irq_level, false, memory_order_relaxed);
   for (hart = 0u; hart < RV32EMU_MAX_HARTS; hart++) {
-    m->plat.clint_mtimecmp[hart] = UINT64_MAX;
-    m->plat.clint_msip[hart] = 0u;
+    atomic_store_explicit(&m->plat.clint[hart].mtimecmp, UINT64_MAX, memory_order_relaxed);
+    atomic_store_explicit(&m->plat.clint[hart].msip, 0u, memory_order_relaxed);
   }
   rv32emu_timer_refresh_deadline(m);
   for (context = 0u; context < RV32EMU_MAX_PLIC_CONTEXTS; context++) {
@@ -107,7 +321,9 @@ bool rv32emu_platform_init(rv32emu_machine_t *m, const rv32emu_options_t *opts)
     cpu->csr[CSR_TIME] = 0;
     atomic_store_explicit(&cpu->lr_valid, false, memory_order_relaxed);
     atomic_store_explicit(&cpu->mip, 0u, memory_order_relaxed);
+    atomic_store_explicit(&cpu->irq_check, true, memory_order_relaxed);
     cpu->timer_batch_ticks = 0u;
+    cpu->timer_batch_limit = 0u;
   }
 
   return true;
@@ -118,10 +334,11 @@ void rv32emu_platform_destroy(rv32emu_machine_t *m) {
     return;
   }
 
-  free(m->plat.dram);
-  m->plat.dram = NULL;
+  rv32emu_phys_map_destroy(m);
+  rv32emu_dirty_map_destroy(m);
+  rv32emu_code_version_destroy(m);
+  rv32emu_dram_unmap(&m->plat);
   m->plat.dram_size = 0;
-  (void)pthread_mutex_destroy(&m->plat.amo_lock);
-  (void)pthread_mutex_destroy(&m->plat.mmio_lock);
-  (void)pthread_mutex_destroy(&m->plat.dram_lock);
+  rv32emu_hart_park_destroy(m);
+  rv32emu_platform_destroy_locks(&m->plat, RV32EMU_MAX_HARTS);
 }
@@ -2,12 +2,16 @@
 
 #include <elf.h>
 #include <limits.h>
+#include <sched.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
 #define RV32EMU_REG_A0 10u
 #define RV32EMU_REG_A1 11u
 #define RV32EMU_REG_A2 12u
+#define RV32EMU_REG_A3 13u
+#define RV32EMU_REG_A4 14u
 #define RV32EMU_REG_A6 16u
 #define RV32EMU_REG_A7 17u
 
@@ -91,8 +95,8 @@ static uint32_t rv32emu_sbi_current_hartid(const rv32emu_machine_t *m) {
 
 static void rv32emu_sbi_sync_timer_pending(rv32emu_machine_t *m) {
   uint32_t hartid = rv32emu_sbi_current_hartid(m);
-  bool expired =
-      atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >= m->plat.clint_mtimecmp[hartid];
+  bool expired = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >=
+                 rv32emu_clint_mtimecmp(m, hartid);
 
   if (m->opts.enable_sbi_shim) {
     if (expired) {
@@ -114,13 +118,98 @@ static void rv32emu_sbi_sync_timer_pending(rv32emu_machine_t *m) {
 static void rv32emu_sbi_set_timer(rv32emu_machine_t *m, uint64_t stime_value) {
   uint32_t hartid = rv32emu_sbi_current_hartid(m);
 
-  if (pthread_mutex_lock(&m->plat.mmio_lock) != 0) {
+  rv32emu_flush_timer(m);
+  if (!rv32emu_plat_lock(m, &m->plat.clint[hartid].lock)) {
     return;
   }
-  m->plat.clint_mtimecmp[hartid] = stime_value;
+  atomic_store(&m->plat.clint[hartid].mtimecmp, stime_value);
   rv32emu_sbi_sync_timer_pending(m);
+  rv32emu_plat_unlock(&m->plat.clint[hartid].lock);
   rv32emu_timer_refresh_deadline(m);
-  (void)pthread_mutex_unlock(&m->plat.mmio_lock);
+  rv32emu_flush_timer(m); /* re-arm the batch against the new deadline */
+}
+
+/*
+ * Wait until target has applied the fences posted under ticket seq:
+ * - with no worker thread executing target (single-thread runs, a worker
+ *   that has exited, or the caller itself) apply them here;
+ * - a parked hart is flushed here under park_lock, which it needs to leave;
+ * - a hart on another worker acknowledges at its next interrupt check,
+ *   i.e. between instructions or translated blocks;
+ * - a stopped hart is not waited for; hart_start clears its TLB.
+ * While waiting the caller takes fences posted to itself, so two harts
+ * fencing each other both finish.
+ */
+static void rv32emu_sbi_fence_sync(rv32emu_machine_t *m, rv32emu_cpu_t *target, unsigned int seq) {
+  rv32emu_cpu_t *self = RV32EMU_CPU(m);
+
+  while (atomic_load_explicit(&target->running, memory_order_acquire) &&
+         (int)(atomic_load_explicit(&target->fence_ack, memory_order_acquire) - seq) < 0) {
+    if (target == self || !atomic_load_explicit(&target->worker_bound, memory_order_acquire)) {
+      rv32emu_tlb_sync_fence(m, target);
+      continue;
+    }
+    if (atomic_load_explicit(&target->wfi_parked, memory_order_acquire)) {
+      (void)pthread_mutex_lock(&target->park_lock);
+      if (atomic_load_explicit(&target->wfi_parked, memory_order_relaxed)) {
+        rv32emu_tlb_sync_fence(m, target);
+      }
+      (void)pthread_mutex_unlock(&target->park_lock);
+      continue;
+    }
+    rv32emu_tlb_sync_fence(m, self);
+    sched_yield();
+  }
+}
+
+/*
+ * Remote fences post into each target hart's fence words (the caller
+ * included) and return once no target can still use a stale translation:
+ * the TLB side is applied or acknowledged (rv32emu_sbi_fence_sync), and
+ * the TB dispatcher drops translated code before its next lookup, which
+ * always follows that point. hart_base == UINT32_MAX selects every hart.
+ * fence.i only drops translated code (tlb_req == 0), sfence.vma also drops
+ * TLB entries.
+ */
+static void rv32emu_sbi_remote_fence(rv32emu_machine_t *m, uint32_t hart_mask, uint32_t hart_base,
+                                     uint32_t tlb_req, uint32_t tb_req) {
+  unsigned int seq[RV32EMU_MAX_HARTS] = {0u};
+  uint32_t targets = 0u;
+
+  for (uint32_t hartid = 0u; hartid < m->hart_count; hartid++) {
+    rv32emu_cpu_t *target;
+
+    if (hart_base != UINT32_MAX &&
+        (hartid < hart_base || hartid - hart_base >= 32u ||
+         (hart_mask & (1u << (hartid - hart_base))) == 0u)) {
+      continue;
+    }
+    target = rv32emu_hart_cpu(m, hartid);
+    if (target == NULL) {
+      continue;
+    }
+    if (tlb_req != 0u) {
+      rv32emu_fence_post(&target->tlb_fence, tlb_req);
+    }
+    rv32emu_fence_post(&target->tb_fence, tb_req);
+    seq[hartid] = atomic_fetch_add_explicit(&target->fence_seq, 1u, memory_order_release) + 1u;
+    /* The TLB fence is only applied by a scan, so raise irq_check after posting it. */
+    rv32emu_cpu_irq_recheck(target);
+    targets |= 1u << hartid;
+  }
+  for (uint32_t hartid = 0u; hartid < m->hart_count; hartid++) {
+    if ((targets & (1u << hartid)) != 0u) {
+      rv32emu_sbi_fence_sync(m, rv32emu_hart_cpu(m, hartid), seq[hartid]);
+    }
+  }
+}
+
+/* A range inside one page becomes a page fence; anything wider flushes everything. */
+static uint32_t rv32emu_sbi_fence_range(uint32_t start, uint32_t size) {
+  if (size == 0u || size == UINT32_MAX || (uint64_t)(start & 0xfffu) + size > 4096u) {
+    return RV32EMU_FENCE_ALL;
+  }
+  return (start & ~0xfffu) | RV32EMU_FENCE_PAGE;
 }
 
 static bool rv32emu_sbi_handle_legacy(rv32emu_machine_t *m, uint32_t eid) {
@@ -144,11 +233,20 @@ static bool rv32emu_sbi_handle_legacy(rv32emu_machine_t *m, uint32_t eid) {
     rv32emu_cpu_mip_set_bits(RV32EMU_CPU(m), MIP_MSIP);
     rv32emu_sbi_set_legacy_ret(m, 0);
     return true;
+  /* Legacy calls pass the hart mask by pointer; fencing every hart is always safe. */
   case SBI_EXT_LEGACY_REMOTE_FENCE_I:
+    rv32emu_sbi_remote_fence(m, 0u, UINT32_MAX, 0u, RV32EMU_FENCE_ALL);
+    rv32emu_sbi_set_legacy_ret(m, 0);
+    return true;
   case SBI_EXT_LEGACY_REMOTE_SFENCE_VMA:
-  case SBI_EXT_LEGACY_REMOTE_SFENCE_VMA_ASID:
+  case SBI_EXT_LEGACY_REMOTE_SFENCE_VMA_ASID: {
+    uint32_t req = rv32emu_sbi_fence_range(RV32EMU_CPU(m)->x[RV32EMU_REG_A1],
+                                           RV32EMU_CPU(m)->x[RV32EMU_REG_A2]);
+
+    rv32emu_sbi_remote_fence(m, 0u, UINT32_MAX, req, req);
     rv32emu_sbi_set_legacy_ret(m, 0);
     return true;
+  }
   case SBI_EXT_LEGACY_SHUTDOWN:
     atomic_store_explicit(&RV32EMU_CPU(m)->running, false, memory_order_release);
     rv32emu_sbi_set_legacy_ret(m, 0);
@@ -231,7 +329,32 @@ static bool rv32emu_sbi_handle_ipi(rv32emu_machine_t *m, uint32_t fid) {
 }
 
 static bool rv32emu_sbi_handle_rfence(rv32emu_machine_t *m, uint32_t fid) {
-  (void)fid;
+  uint32_t hart_mask = RV32EMU_CPU(m)->x[RV32EMU_REG_A0];
+  uint32_t hart_base = RV32EMU_CPU(m)->x[RV32EMU_REG_A1];
+  uint32_t req;
+
+  switch (fid) {
+  case 0u: /* remote_fence_i */
+    rv32emu_sbi_remote_fence(m, hart_mask, hart_base, 0u, RV32EMU_FENCE_ALL);
+    break;
+  case 1u: /* remote_sfence_vma */
+    req = rv32emu_sbi_fence_range(RV32EMU_CPU(m)->x[RV32EMU_REG_A2],
+                                  RV32EMU_CPU(m)->x[RV32EMU_REG_A3]);
+    rv32emu_sbi_remote_fence(m, hart_mask, hart_base, req, req);
+    break;
+  case 2u: /* remote_sfence_vma_asid: the TLB is untagged, only TB lines are per ASID */
+    req = rv32emu_sbi_fence_range(RV32EMU_CPU(m)->x[RV32EMU_REG_A2],
+                                  RV32EMU_CPU(m)->x[RV32EMU_REG_A3]);
+    rv32emu_sbi_remote_fence(m, hart_mask, hart_base, req,
+                             req == RV32EMU_FENCE_ALL
+                                 ? ((RV32EMU_CPU(m)->x[RV32EMU_REG_A4] & 0x1ffu) << 12) |
+                                       RV32EMU_FENCE_ASID
+                                 : req);
+    break;
+  default: /* hypervisor fences */
+    rv32emu_sbi_set_ret(m, SBI_ERR_NOT_SUPPORTED, 0);
+    return true;
+  }
   rv32emu_sbi_set_ret(m, SBI_ERR_SUCCESS, 0);
   return true;
 }
@@ -252,27 +375,32 @@ static bool rv32emu_sbi_handle_hsm(rv32emu_machine_t *m, uint32_t fid) {
       rv32emu_sbi_set_ret(m, SBI_ERR_ALREADY_AVAILABLE, 0);
       return true;
     }
-    memset(target, 0, sizeof(*target));
+    rv32emu_lr_clear(m, target);
+    memset(target, 0, offsetof(rv32emu_cpu_t, worker_bound));
     atomic_init(&target->running, false);
     atomic_init(&target->lr_valid, false);
     atomic_init(&target->mip, 0u);
+    atomic_init(&target->tlb_fence, 0u);
+    atomic_init(&target->tb_fence, RV32EMU_FENCE_ALL); /* the hart may be restarted on new code */
     memcpy(target->csr, RV32EMU_CPU(m)->csr, sizeof(target->csr));
     target->pc = RV32EMU_CPU(m)->x[RV32EMU_REG_A1];
     target->x[RV32EMU_REG_A0] = hartid;
     target->x[RV32EMU_REG_A1] = RV32EMU_CPU(m)->x[RV32EMU_REG_A2];
     target->priv = RV32EMU_PRIV_S;
     target->trace = m->opts.trace;
+    rv32emu_cpu_irq_recheck(target);
     target->csr[CSR_MHARTID] = hartid;
     target->csr[CSR_MISA] = rv32emu_default_misa_value();
     target->csr[CSR_TIME] = (uint32_t)atomic_load_explicit(&m->plat.mtime, memory_order_relaxed);
     target->timer_batch_ticks = 0u;
+    target->timer_batch_limit = 0u;
     rv32emu_cpu_mip_clear_bits(target, MIP_MSIP | MIP_SSIP | MIP_STIP | MIP_MTIP | MIP_SEIP |
                                           MIP_MEIP);
-    if (m->plat.clint_msip[hartid] != 0u) {
+    if (atomic_load_explicit(&m->plat.clint[hartid].msip, memory_order_relaxed) != 0u) {
       rv32emu_cpu_mip_set_bits(target, MIP_MSIP);
     }
-    expired =
-        atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >= m->plat.clint_mtimecmp[hartid];
+    expired = atomic_load_explicit(&m->plat.mtime, memory_order_relaxed) >=
+              rv32emu_clint_mtimecmp(m, hartid);
     if (m->opts.enable_sbi_shim) {
       if (expired) {
         rv32emu_cpu_mip_set_bits(target, MIP_STIP);
@@ -461,6 +589,7 @@ bool rv32emu_load_raw(rv32emu_machine_t *m, const char *path, uint32_t load_addr
   }
 
   fclose(fp);
+  rv32emu_note_dram_write(m, load_addr, (uint32_t)file_size);
   if (size_out != NULL) {
     *size_out = (uint32_t)file_size;
   }
@@ -531,6 +660,7 @@ bool rv32emu_load_elf32(rv32emu_machine_t *m, const char *path, uint32_t *entry_
     }
 
     memset(dst, 0, phdr.p_memsz);
+    rv32emu_note_dram_write(m, seg_addr, phdr.p_memsz);
     if (phdr.p_filesz > 0u) {
       if (fseek(fp, (long)phdr.p_offset, SEEK_SET) != 0 ||
           fread(dst, 1, phdr.p_filesz, fp) != phdr.p_filesz) {
@@ -12,9 +12,7 @@ int rv32emu_jit_block_commit(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_t
   cpu->x[0] = 0u;
   cpu->cycle += retired;
   cpu->instret += retired;
-  for (uint32_t i = 0u; i < retired; i++) {
-    rv32emu_step_timer(m);
-  }
+  rv32emu_advance_timer(m, retired);
 
   g_rv32emu_jit_tls_total += retired;
   if (g_rv32emu_jit_tls_budget > retired) {
@@ -34,9 +32,7 @@ void rv32emu_jit_retire_prefix(rv32emu_machine_t *m, rv32emu_cpu_t *cpu, uint32_
   cpu->x[0] = 0u;
   cpu->cycle += retired;
   cpu->instret += retired;
-  for (uint32_t i = 0u; i < retired; i++) {
-    rv32emu_step_timer(m);
-  }
+  rv32emu_advance_timer(m, retired);
 
   g_rv32emu_jit_tls_total += retired;
   if (g_rv32emu_jit_tls_budget > retired) {
@@ -82,6 +78,12 @@ int rv32emu_jit_pre_dispatch(rv32emu_machine_t *m, rv32emu_cpu_t *cpu) {
     return -1;
   }
 
+  /* An SBI rfence acknowledged above may have dropped this very block. */
+  if (atomic_load_explicit(&cpu->tb_fence, memory_order_relaxed) != 0u) {
+    g_rv32emu_jit_tls_handled = true;
+    return -1;
+  }
+
   return 0;
 }
 #endif
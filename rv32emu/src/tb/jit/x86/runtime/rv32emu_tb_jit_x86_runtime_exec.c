@@ -11,10 +11,6 @@ static inline void rv32emu_jit_write_rd(rv32emu_cpu_t *cpu, uint32_t rd, uint32_
 static bool rv32emu_jit_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t funct3,
                                    uint32_t *value_out) {
   uint32_t raw = 0u;
-  uint32_t b0 = 0u;
-  uint32_t b1 = 0u;
-  uint32_t b2 = 0u;
-  uint32_t b3 = 0u;
 
   if (m == NULL || value_out == NULL) {
     return false;
@@ -28,32 +24,13 @@ static bool rv32emu_jit_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t
     *value_out = rv32emu_sign_extend(raw & 0xffu, 8);
     return true;
   case 0x1: /* lh */
-    if ((addr & 1u) == 0u) {
-      if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
-        return false;
-      }
-    } else {
-      if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-          !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1)) {
-        return false;
-      }
-      raw = (b0 & 0xffu) | ((b1 & 0xffu) << 8);
+    if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
+      return false;
     }
     *value_out = rv32emu_sign_extend(raw & 0xffffu, 16);
     return true;
   case 0x2: /* lw */
-    if ((addr & 3u) == 0u) {
-      return rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, value_out);
-    }
-    if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-        !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1) ||
-        !rv32emu_virt_read(m, addr + 2u, 1, RV32EMU_ACC_LOAD, &b2) ||
-        !rv32emu_virt_read(m, addr + 3u, 1, RV32EMU_ACC_LOAD, &b3)) {
-      return false;
-    }
-    *value_out = (b0 & 0xffu) | ((b1 & 0xffu) << 8) | ((b2 & 0xffu) << 16) |
-                 ((b3 & 0xffu) << 24);
-    return true;
+    return rv32emu_virt_read(m, addr, 4, RV32EMU_ACC_LOAD, value_out);
   case 0x4: /* lbu */
     if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &raw)) {
       return false;
@@ -61,16 +38,8 @@ static bool rv32emu_jit_load_value(rv32emu_machine_t *m, uint32_t addr, uint32_t
     *value_out = raw & 0xffu;
     return true;
   case 0x5: /* lhu */
-    if ((addr & 1u) == 0u) {
-      if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
-        return false;
-      }
-    } else {
-      if (!rv32emu_virt_read(m, addr, 1, RV32EMU_ACC_LOAD, &b0) ||
-          !rv32emu_virt_read(m, addr + 1u, 1, RV32EMU_ACC_LOAD, &b1)) {
-        return false;
-      }
-      raw = (b0 & 0xffu) | ((b1 & 0xffu) << 8);
+    if (!rv32emu_virt_read(m, addr, 2, RV32EMU_ACC_LOAD, &raw)) {
+      return false;
     }
     *value_out = raw & 0xffffu;
     return true;
@@ -113,19 +82,9 @@ static bool rv32emu_jit_store_value(rv32emu_machine_t *m, uint32_t addr, uint32_
   case 0x0: /* sb */
     return rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value);
   case 0x1: /* sh */
-    if ((addr & 1u) == 0u) {
-      return rv32emu_virt_write(m, addr, 2, RV32EMU_ACC_STORE, value);
-    }
-    return rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value & 0xffu) &&
-           rv32emu_virt_write(m, addr + 1u, 1, RV32EMU_ACC_STORE, (value >> 8) & 0xffu);
+    return rv32emu_virt_write(m, addr, 2, RV32EMU_ACC_STORE, value);
   case 0x2: /* sw */
-    if ((addr & 3u) == 0u) {
-      return rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, value);
-    }
-    return rv32emu_virt_write(m, addr, 1, RV32EMU_ACC_STORE, value & 0xffu) &&
-           rv32emu_virt_write(m, addr + 1u, 1, RV32EMU_ACC_STORE, (value >> 8) & 0xffu) &&
-           rv32emu_virt_write(m, addr + 2u, 1, RV32EMU_ACC_STORE, (value >> 16) & 0xffu) &&
-           rv32emu_virt_write(m, addr + 3u, 1, RV32EMU_ACC_STORE, (value >> 24) & 0xffu);
+    return rv32emu_virt_write(m, addr, 4, RV32EMU_ACC_STORE, value);
   default:
     return false;
   }
@@ -182,6 +141,7 @@ uint32_t rv32emu_jit_exec_mem(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
     return 0u;
   case 0x23: /* store */
     addr = rs1v + (uint32_t)effective->imm_s;
+    cpu->code_written = false;
     ok = rv32emu_jit_store_value(m, addr, effective->funct3, rs2v);
     if (!ok) {
       if (effective->funct3 != 0x0u && effective->funct3 != 0x1u && effective->funct3 != 0x2u) {
@@ -193,6 +153,11 @@ uint32_t rv32emu_jit_exec_mem(rv32emu_machine_t *m, rv32emu_cpu_t *cpu,
       g_rv32emu_jit_tls_handled = true;
       return rv32emu_jit_result_or_no_retire();
     }
+    if (cpu->code_written) {
+      /* Store hit translated code: retire it and leave so dispatch rebuilds. */
+      return (uint32_t)rv32emu_jit_block_commit(
+          m, cpu, insn_pc + ((effective->insn_len == 2u) ? 2u : 4u), retired_prefix + 1u);
+    }
     return 0u;
   default:
     rv32emu_raise_exception(m, RV32EMU_EXC_ILLEGAL_INST, effective->raw);
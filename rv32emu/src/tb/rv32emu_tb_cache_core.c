@@ -5,8 +5,9 @@ _Static_assert((RV32EMU_JIT_TEMPLATE_CACHE_LINES &
                 (RV32EMU_JIT_TEMPLATE_CACHE_LINES - 1u)) == 0u,
                "template cache lines must be a power of two");
 
-static inline uint32_t rv32emu_tb_index(uint32_t pc) {
-  return (pc >> 2) & (RV32EMU_TB_LINES - 1u);
+/* The context hash spreads the same pc from different address spaces over different sets. */
+static inline uint32_t rv32emu_tb_index(const rv32emu_tb_cache_t *cache, uint32_t pc) {
+  return ((pc >> 2) ^ cache->ctx_mix) & (RV32EMU_TB_LINES - 1u);
 }
 
 static inline uint32_t rv32emu_tb_slot(uint32_t set_idx, uint32_t way) {
@@ -39,10 +40,11 @@ rv32emu_tb_line_t *rv32emu_tb_find_cached_line(rv32emu_tb_cache_t *cache, uint32
     return NULL;
   }
 
-  set_idx = rv32emu_tb_index(pc);
+  set_idx = rv32emu_tb_index(cache, pc);
   for (uint32_t way = 0u; way < RV32EMU_TB_WAYS; way++) {
     rv32emu_tb_line_t *line = &cache->lines[rv32emu_tb_slot(set_idx, way)];
-    if (line->valid && line->start_pc == pc) {
+    if (line->valid && line->start_pc == pc && line->ctx_satp == cache->ctx_satp &&
+        line->ctx_priv == cache->ctx_priv) {
       return line;
     }
   }
@@ -78,13 +80,36 @@ static rv32emu_tb_line_t *rv32emu_tb_pick_victim_line(rv32emu_tb_cache_t *cache,
   return best_line;
 }
 
-static bool rv32emu_tb_is_block_terminator(uint32_t opcode) {
-  switch (opcode) {
+/* csrr rd, time/timeh: reads the clock and nothing else. */
+static bool rv32emu_tb_is_time_read(const rv32emu_decoded_insn_t *d) {
+  uint32_t csr = (uint32_t)d->imm_i & 0xfffu;
+
+  if (d->opcode != 0x73 || (csr != CSR_TIME && csr != CSR_TIMEH)) {
+    return false;
+  }
+  switch (d->funct3) {
+  case 0x2: /* csrrs */
+  case 0x3: /* csrrc */
+  case 0x6: /* csrrsi */
+  case 0x7: /* csrrci */
+    return d->rs1 == 0u;
+  default:
+    return false;
+  }
+}
+
+static bool rv32emu_tb_is_block_terminator(const rv32emu_decoded_insn_t *d) {
+  if (rv32emu_tb_is_time_read(d)) {
+    return false; /* keeps rdtime polling loops inside one line */
+  }
+  switch (d->opcode) {
   case 0x63: /* branch */
   case 0x67: /* jalr */
   case 0x6f: /* jal */
   case 0x73: /* system */
     return true;
+  case 0x0f: /* fence.i: the lines after it may be flushed */
+    return d->funct3 == 0x1u;
   default:
     return false;
   }
@@ -94,7 +119,13 @@ void rv32emu_tb_cache_reset(rv32emu_tb_cache_t *cache) {
   if (cache == NULL) {
     return;
   }
+  cache->ctx_satp = 0u;
+  cache->ctx_priv = RV32EMU_PRIV_M;
+  cache->ctx_mix = 0u;
   cache->active = false;
+  cache->spin_pc = 0u;
+  cache->spin_iters = 0u;
+  cache->spin_step = 0u;
   cache->jit_hot_threshold = rv32emu_tb_hot_threshold_from_env();
   cache->jit_max_block_insns = rv32emu_tb_max_block_insns_from_env();
   cache->jit_min_prefix_insns = rv32emu_tb_min_prefix_insns_from_env();
@@ -117,7 +148,10 @@ void rv32emu_tb_cache_reset(rv32emu_tb_cache_t *cache) {
   for (uint32_t i = 0u; i < RV32EMU_TB_TOTAL_LINES; i++) {
     cache->lines[i].valid = false;
     cache->lines[i].start_pc = 0u;
+    cache->lines[i].ctx_satp = 0u;
+    cache->lines[i].ctx_priv = RV32EMU_PRIV_M;
     cache->lines[i].count = 0u;
+    cache->lines[i].code_page_count = 0u;
     cache->lines[i].jit_hotness = 0u;
     cache->lines[i].jit_tried = false;
     cache->lines[i].jit_valid = false;
@@ -135,16 +169,166 @@ void rv32emu_tb_cache_reset(rv32emu_tb_cache_t *cache) {
   }
 }
 
-static bool rv32emu_tb_build_line(rv32emu_machine_t *m, rv32emu_tb_line_t *line, uint32_t start_pc) {
+static void rv32emu_tb_line_invalidate(rv32emu_tb_line_t *line) {
+  line->valid = false;
+  line->jit_valid = false;
+  line->jit_state = RV32EMU_JIT_STATE_NONE;
+  line->jit_generation = rv32emu_tb_next_jit_generation(); /* orphan queued async jobs */
+  line->jit_fn = NULL;
+  line->jit_chain_valid = false;
+  line->jit_chain_pc = 0u;
+  line->jit_chain_fn = NULL;
+}
+
+/*
+ * Apply one pending fence request (RV32EMU_FENCE_ALL, page | RV32EMU_FENCE_PAGE or
+ * asid << 12 | RV32EMU_FENCE_ASID).
+ * A page flush drops every line that starts on or runs into that virtual page;
+ * an ASID flush drops the lines decoded under that ASID with translation on.
+ */
+void rv32emu_tb_cache_apply_fence(rv32emu_tb_cache_t *cache, uint32_t req) {
+  uint32_t vpn = req >> 12;
+  bool asid_only = (req & RV32EMU_FENCE_ASID) != 0u;
+
+  if (cache == NULL || req == 0u) {
+    return;
+  }
+
+  cache->active = false;
+  for (uint32_t i = 0u; i < RV32EMU_TB_TOTAL_LINES; i++) {
+    rv32emu_tb_line_t *line = &cache->lines[i];
+
+    if (!line->valid) {
+      continue;
+    }
+    if (asid_only) {
+      if (line->ctx_satp == 0u || ((line->ctx_satp >> 22) & 0x1ffu) != vpn) {
+        continue;
+      }
+    } else if (req != RV32EMU_FENCE_ALL && (line->start_pc >> 12) != vpn &&
+               (line->count == 0u || ((line->pcs[line->count - 1u] + 2u) >> 12) != vpn)) {
+      continue;
+    }
+    rv32emu_tb_line_invalidate(line);
+    RV32EMU_JIT_STATS_INC(fence_invalidations);
+  }
+}
+
+/*
+ * Line builds fetch through a per-page cursor: each code page is translated
+ * once, registered as a code source of the line before anything is read from
+ * it (so a later store always changes the saved version), and parcels are
+ * then read straight from host memory. Only the line's first instruction may
+ * trap; past it a page that does not translate without side effects, or is
+ * not DRAM, just ends the line and the next dispatch from there faults for real.
+ */
+typedef struct {
+  uint32_t vpn;
+  uint8_t *host_page;
+} rv32emu_tb_fetch_cursor_t;
+
+static bool rv32emu_tb_fetch_parcel(rv32emu_machine_t *m, rv32emu_tb_line_t *line,
+                                    rv32emu_tb_fetch_cursor_t *cursor, uint32_t vaddr,
+                                    uint32_t *out) {
+  bool first = line->count == 0u;
+
+  if (cursor->vpn != (vaddr >> 12)) {
+    uint32_t paddr;
+    uint32_t page;
+    uint32_t version;
+
+    if (line->code_page_count >= RV32EMU_TB_MAX_CODE_PAGES ||
+        !rv32emu_translate_fetch(m, vaddr, !first, &paddr, &cursor->host_page)) {
+      return false;
+    }
+    cursor->vpn = vaddr >> 12;
+    if (rv32emu_code_watch_page(m, paddr, &page, &version)) {
+      line->code_page[line->code_page_count] = page;
+      line->code_version[line->code_page_count] = version;
+      line->code_page_count++;
+    }
+  }
+  if (cursor->host_page != NULL) {
+    *out = __atomic_load_n((const uint16_t *)(const void *)(cursor->host_page + (vaddr & 0xfffu)),
+                           __ATOMIC_RELAXED);
+    return true;
+  }
+  return first && rv32emu_virt_read(m, vaddr, 2, RV32EMU_ACC_FETCH, out);
+}
+
+/*
+ * A spin loop is a line that branches back to its own start and otherwise
+ * only computes in registers and reads the time: csrr time/timeh, or lw from
+ * a base register the line never writes (checked to be CLINT mtime before
+ * each warp). Such a loop only exits once mtime moves, so it may be warped.
+ */
+static bool rv32emu_tb_line_spins(const rv32emu_tb_line_t *line, bool *loads_out) {
+  const rv32emu_decoded_insn_t *tail;
+  uint32_t written = 0u;
+  bool reads_time = false;
+
+  *loads_out = false;
+  if (line->count < 2u) {
+    return false;
+  }
+  tail = &line->decoded[line->count - 1u];
+  if (tail->opcode != 0x63 || line->pcs[line->count - 1u] + (uint32_t)tail->imm_b != line->start_pc) {
+    return false;
+  }
+  for (uint32_t i = 0u; i + 1u < line->count; i++) {
+    written |= 1u << line->decoded[i].rd;
+  }
+  written &= ~1u; /* x0 */
+  for (uint32_t i = 0u; i + 1u < line->count; i++) {
+    const rv32emu_decoded_insn_t *d = &line->decoded[i];
+
+    switch (d->opcode) {
+    case 0x13: /* op-imm */
+    case 0x33: /* op */
+    case 0x37: /* lui */
+    case 0x17: /* auipc */
+      break;
+    case 0x0f: /* fence, pause */
+      if (d->funct3 != 0x0u) {
+        return false;
+      }
+      break;
+    case 0x03: /* lw */
+      if (d->funct3 != 0x2u || (written & (1u << d->rs1)) != 0u) {
+        return false;
+      }
+      *loads_out = true;
+      reads_time = true;
+      break;
+    default:
+      if (!rv32emu_tb_is_time_read(d)) {
+        return false;
+      }
+      reads_time = true;
+      break;
+    }
+  }
+  return reads_time;
+}
+
+static bool rv32emu_tb_build_line(rv32emu_machine_t *m, const rv32emu_tb_cache_t *cache,
+                                  rv32emu_tb_line_t *line, uint32_t start_pc) {
   uint32_t pc = start_pc;
+  rv32emu_tb_fetch_cursor_t cursor = {UINT32_MAX, NULL};
 
   if (m == NULL || line == NULL) {
     return false;
   }
 
+  RV32EMU_JIT_STATS_INC(tb_builds);
   line->valid = false;
   line->count = 0u;
   line->start_pc = start_pc;
+  line->ctx_satp = cache->ctx_satp;
+  line->ctx_priv = cache->ctx_priv;
+  line->code_page_count = 0u;
+  line->spin_loop = false;
+  line->spin_loads = false;
   line->jit_hotness = 0u;
   line->jit_tried = false;
   line->jit_valid = false;
@@ -162,13 +346,10 @@ static bool rv32emu_tb_build_line(rv32emu_machine_t *m, rv32emu_tb_line_t *line,
 
   for (uint32_t i = 0u; i < RV32EMU_TB_MAX_INSNS; i++) {
     uint32_t insn16 = 0u;
-    uint32_t insn32 = 0u;
+    uint32_t hi16 = 0u;
     uint32_t step = 4u;
 
-    if ((pc & 1u) != 0u) {
-      break;
-    }
-    if (!rv32emu_virt_read(m, pc, 2, RV32EMU_ACC_FETCH, &insn16)) {
+    if ((pc & 1u) != 0u || !rv32emu_tb_fetch_parcel(m, line, &cursor, pc, &insn16)) {
       break;
     }
     line->pcs[line->count] = pc;
@@ -178,20 +359,22 @@ static bool rv32emu_tb_build_line(rv32emu_machine_t *m, rv32emu_tb_line_t *line,
       }
       step = 2u;
     } else {
-      if (!rv32emu_virt_read(m, pc, 4, RV32EMU_ACC_FETCH, &insn32)) {
+      if (!rv32emu_tb_fetch_parcel(m, line, &cursor, pc + 2u, &hi16)) {
         break;
       }
-      rv32emu_decode32(insn32, &line->decoded[line->count]);
+      rv32emu_decode32(insn16 | (hi16 << 16), &line->decoded[line->count]);
       step = 4u;
     }
+    line->exec[line->count] = rv32emu_exec_bind(&line->decoded[line->count]);
     line->count++;
     pc += step;
 
-    if (rv32emu_tb_is_block_terminator(line->decoded[line->count - 1u].opcode)) {
+    if (rv32emu_tb_is_block_terminator(&line->decoded[line->count - 1u])) {
       break;
     }
   }
 
+  line->spin_loop = rv32emu_tb_line_spins(line, &line->spin_loads);
   line->valid = true;
   return true;
 }
@@ -207,10 +390,18 @@ rv32emu_tb_line_t *rv32emu_tb_lookup_or_build(rv32emu_machine_t *m, rv32emu_tb_c
 
   line = rv32emu_tb_find_cached_line(cache, pc);
   if (line != NULL) {
-    return line;
+    if (rv32emu_tb_line_code_current(m, line)) {
+      return line;
+    }
+    /* Guest code under the line was written: rebuild it in place. */
+    if (line->jit_state == RV32EMU_JIT_STATE_QUEUED) {
+      RV32EMU_JIT_STATS_INC(async_evict_queued);
+    }
+    RV32EMU_JIT_STATS_INC(code_invalidations);
+    return rv32emu_tb_build_line(m, cache, line, pc) ? line : NULL;
   }
 
-  set_idx = rv32emu_tb_index(pc);
+  set_idx = rv32emu_tb_index(cache, pc);
   line = rv32emu_tb_pick_victim_line(cache, set_idx);
   if (line == NULL) {
     return NULL;
@@ -218,7 +409,7 @@ rv32emu_tb_line_t *rv32emu_tb_lookup_or_build(rv32emu_machine_t *m, rv32emu_tb_c
   if (line->valid && line->jit_state == RV32EMU_JIT_STATE_QUEUED) {
     RV32EMU_JIT_STATS_INC(async_evict_queued);
   }
-  if (!rv32emu_tb_build_line(m, line, pc)) {
+  if (!rv32emu_tb_build_line(m, cache, line, pc)) {
     return NULL;
   }
   return line;
@@ -9,7 +9,9 @@
 #include <sys/mman.h>
 #endif
 
-bool rv32emu_exec_decoded(rv32emu_machine_t *m, const rv32emu_decoded_insn_t *decoded);
+static inline bool rv32emu_tb_insn_may_write_memory(uint32_t opcode) {
+  return opcode == 0x23u || opcode == 0x27u || opcode == 0x2fu; /* store, fp store, amo */
+}
 
 #if defined(__x86_64__)
 static bool rv32emu_tb_line_jit_ready(const rv32emu_tb_line_t *line) {
@@ -52,31 +54,6 @@ static uint32_t rv32emu_tb_jit_compile_threshold(const rv32emu_tb_cache_t *cache
   return threshold;
 }
 
-static bool rv32emu_tb_jit_prefix_matches_guest(rv32emu_machine_t *m, const rv32emu_tb_line_t *line) {
-  if (m == NULL || line == NULL || !line->jit_valid || line->jit_count == 0u ||
-      line->jit_count > line->count) {
-    return false;
-  }
-
-  for (uint8_t i = 0u; i < line->jit_count; i++) {
-    uint8_t len = (line->decoded[i].insn_len == 2u) ? 2u : 4u;
-    uint32_t raw = 0u;
-
-    if (!rv32emu_virt_read(m, line->pcs[i], len, RV32EMU_ACC_FETCH, &raw)) {
-      return false;
-    }
-    if (len == 2u) {
-      if ((line->decoded[i].raw & 0xffffu) != (raw & 0xffffu)) {
-        return false;
-      }
-    } else if (line->decoded[i].raw != raw) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
 static uint8_t rv32emu_tb_collect_static_successors(const rv32emu_tb_line_t *line,
                                                     uint32_t succ_out[2]) {
   const rv32emu_decoded_insn_t *tail;
@@ -192,6 +169,9 @@ static bool rv32emu_tb_get_ready_jit_line(rv32emu_machine_t *m, rv32emu_tb_cache
   if (line == NULL || line->start_pc != pc) {
     return false;
   }
+  if (line->spin_loop) {
+    return false; /* stays on rv32emu_exec_tb_block(), which can warp it */
+  }
 
   if (!rv32emu_tb_line_jit_ready(line) && line->jit_state == RV32EMU_JIT_STATE_NONE) {
     if (line->jit_hotness < 255u) {
@@ -226,18 +206,10 @@ static bool rv32emu_tb_get_ready_jit_line(rv32emu_machine_t *m, rv32emu_tb_cache
     }
   }
 
+  /* rv32emu_tb_lookup_or_build() already rebuilt the line if its code pages were written. */
   if (!rv32emu_tb_line_jit_ready(line)) {
     return false;
   }
-  if (async_runtime_ok && !rv32emu_tb_jit_prefix_matches_guest(m, line)) {
-    line->valid = false;
-    line->jit_hotness = 0u;
-    line->jit_tried = false;
-    line->jit_generation = rv32emu_tb_next_jit_generation();
-    rv32emu_tb_line_clear_jit(line, RV32EMU_JIT_STATE_NONE);
-    RV32EMU_JIT_STATS_INC(async_results_stale);
-    return false;
-  }
   if (async_runtime_ok) {
     rv32emu_tb_async_prefetch_successors(m, cache, line);
   }
@@ -249,7 +221,8 @@ static bool rv32emu_tb_get_ready_jit_line(rv32emu_machine_t *m, rv32emu_tb_cache
   return true;
 }
 
-static rv32emu_tb_line_t *rv32emu_tb_try_cached_chain(rv32emu_tb_cache_t *cache,
+static rv32emu_tb_line_t *rv32emu_tb_try_cached_chain(rv32emu_machine_t *m,
+                                                       rv32emu_tb_cache_t *cache,
                                                        rv32emu_tb_line_t *from, uint32_t next_pc,
                                                        uint64_t budget) {
   rv32emu_tb_line_t *line;
@@ -261,7 +234,7 @@ static rv32emu_tb_line_t *rv32emu_tb_try_cached_chain(rv32emu_tb_cache_t *cache,
 
   line = rv32emu_tb_find_cached_line(cache, next_pc);
   if (line == NULL || !rv32emu_tb_line_jit_ready(line) || line->jit_fn != from->jit_chain_fn ||
-      (uint64_t)line->jit_count > budget) {
+      (uint64_t)line->jit_count > budget || !rv32emu_tb_line_code_current(m, line)) {
     from->jit_chain_valid = false;
     from->jit_chain_pc = 0u;
     from->jit_chain_fn = NULL;
@@ -301,9 +274,13 @@ rv32emu_tb_jit_fn_t rv32emu_jit_chain_next(rv32emu_machine_t *m, rv32emu_cpu_t *
   if (!atomic_load_explicit(&cpu->running, memory_order_acquire)) {
     return NULL;
   }
+  if (atomic_load_explicit(&cpu->tb_fence, memory_order_relaxed) != 0u) {
+    return NULL; /* back to the dispatcher, which applies the fence before the next lookup */
+  }
+  rv32emu_tb_cache_sync(cache, cpu); /* the block may have switched satp or privilege */
 
   next_pc = cpu->pc;
-  next_line = rv32emu_tb_try_cached_chain(cache, from, next_pc, budget);
+  next_line = rv32emu_tb_try_cached_chain(m, cache, from, next_pc, budget);
   if (next_line == NULL) {
     RV32EMU_JIT_STATS_INC(chain_misses);
     if (!rv32emu_tb_get_ready_jit_line(m, cache, next_pc, budget, &next_line)) {
@@ -370,6 +347,7 @@ rv32emu_tb_jit_result_t rv32emu_exec_tb_jit(rv32emu_machine_t *m, rv32emu_tb_cac
     RV32EMU_JIT_STATS_INC(dispatch_budget_clamped);
   }
 
+  rv32emu_tb_cache_sync(cache, cpu);
   pc = cpu->pc;
   if (!rv32emu_tb_get_ready_jit_line(m, cache, pc, local_budget, &line)) {
     RV32EMU_JIT_STATS_INC(dispatch_no_ready);
@@ -426,6 +404,56 @@ rv32emu_tb_jit_result_t rv32emu_exec_tb_jit(rv32emu_machine_t *m, rv32emu_tb_cac
 #endif
 }
 
+/* Loads of a spin loop with MMU off for data: each must hit CLINT mtime/mtimeh. */
+static bool rv32emu_tb_spin_loads_mtime(rv32emu_machine_t *m, const rv32emu_cpu_t *cpu,
+                                        const rv32emu_tb_line_t *line) {
+  if ((cpu->csr[CSR_SATP] >> 31) != 0u /* Sv32 */ &&
+      (cpu->priv != RV32EMU_PRIV_M || (rv32emu_csr_read(m, CSR_MSTATUS) & MSTATUS_MPRV) != 0u)) {
+    return false;
+  }
+  for (uint32_t i = 0u; i + 1u < line->count; i++) {
+    const rv32emu_decoded_insn_t *d = &line->decoded[i];
+
+    if (d->opcode == 0x03 &&
+        cpu->x[d->rs1] + (uint32_t)d->imm_i - (RV32EMU_CLINT_BASE + 0xbff8u) >= 8u) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * One full pass of a spin_loop line that branched back to its start: after
+ * RV32EMU_TB_SPIN_MIN_ITERS in a row, each pass warps mtime forward by a
+ * step that doubles up to RV32EMU_TB_SPIN_WARP_MAX_TICKS, so the loop's
+ * exit condition is reached in a few dozen passes and is overshot by at
+ * most one step. Warps never pass the next timer deadline.
+ */
+static void rv32emu_tb_spin_iteration(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache,
+                                      const rv32emu_cpu_t *cpu, const rv32emu_tb_line_t *line) {
+  if (cpu->pc != line->start_pc) {
+    cache->spin_iters = 0u; /* loop exited */
+    return;
+  }
+  if (cache->spin_pc != line->start_pc) {
+    cache->spin_pc = line->start_pc;
+    cache->spin_iters = 0u;
+  }
+  if (cache->spin_iters < RV32EMU_TB_SPIN_MIN_ITERS) {
+    if (++cache->spin_iters == RV32EMU_TB_SPIN_MIN_ITERS) {
+      cache->spin_step = RV32EMU_TB_SPIN_WARP_MIN_TICKS;
+    }
+    return;
+  }
+  if (line->spin_loads && !rv32emu_tb_spin_loads_mtime(m, cpu, line)) {
+    return;
+  }
+  if (rv32emu_timer_spin_warp(m, cache->spin_step) != 0u &&
+      cache->spin_step < RV32EMU_TB_SPIN_WARP_MAX_TICKS) {
+    cache->spin_step <<= 1;
+  }
+}
+
 rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache,
                                                  uint64_t budget) {
   rv32emu_tb_block_result_t result = {RV32EMU_TB_BLOCK_NOPROGRESS, 0u};
@@ -467,6 +495,7 @@ rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb
       return result;
     }
 
+    rv32emu_tb_cache_sync(cache, cpu);
     pc = cpu->pc;
     if (cache->active) {
       rv32emu_tb_line_t *active = rv32emu_tb_lookup_or_build(m, cache, cache->active_start_pc);
@@ -503,7 +532,7 @@ rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb
         return result;
       }
 
-      if (!rv32emu_exec_decoded(m, &line->decoded[index])) {
+      if (!line->exec[index](m, cpu, &line->decoded[index])) {
         cache->active = false;
         if (result.retired != 0u) {
           result.status = RV32EMU_TB_BLOCK_RETIRED;
@@ -515,6 +544,13 @@ rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb
       }
       result.retired++;
 
+      /* Eager SMC check: a store that hit this line's code ends it; the next lookup rebuilds. */
+      if (rv32emu_tb_insn_may_write_memory(line->decoded[index].opcode) &&
+          !rv32emu_tb_line_code_current(m, line)) {
+        cache->active = false;
+        break;
+      }
+
       if (index + 1u < line->count && cpu->pc == line->pcs[index + 1u]) {
         cache->active = true;
         cache->active_start_pc = line->start_pc;
@@ -523,6 +559,9 @@ rv32emu_tb_block_result_t rv32emu_exec_tb_block(rv32emu_machine_t *m, rv32emu_tb
         continue;
       }
 
+      if (line->spin_loop && index + 1u == line->count) {
+        rv32emu_tb_spin_iteration(m, cache, cpu, line);
+      }
       cache->active = false;
       break;
     }
@@ -543,6 +582,7 @@ bool rv32emu_exec_one_tb(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache) {
     return false;
   }
 
+  rv32emu_tb_cache_sync(cache, RV32EMU_CPU(m));
   pc = RV32EMU_CPU(m)->pc;
   line = NULL;
   index = 0u;
@@ -570,7 +610,7 @@ bool rv32emu_exec_one_tb(rv32emu_machine_t *m, rv32emu_tb_cache_t *cache) {
     index = 0u;
   }
 
-  if (!rv32emu_exec_decoded(m, &line->decoded[index])) {
+  if (!line->exec[index](m, RV32EMU_CPU(m), &line->decoded[index])) {
     cache->active = false;
     return false;
   }
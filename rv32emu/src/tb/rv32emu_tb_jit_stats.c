@@ -29,6 +29,9 @@ rv32emu_jit_stats_t g_rv32emu_jit_stats = {
     .helper_cf_calls = ATOMIC_VAR_INIT(0u),
     .chain_hits = ATOMIC_VAR_INIT(0u),
     .chain_misses = ATOMIC_VAR_INIT(0u),
+    .code_invalidations = ATOMIC_VAR_INIT(0u),
+    .fence_invalidations = ATOMIC_VAR_INIT(0u),
+    .tb_builds = ATOMIC_VAR_INIT(0u),
     .async_jobs_enqueued = ATOMIC_VAR_INIT(0u),
     .async_jobs_dropped = ATOMIC_VAR_INIT(0u),
     .async_jobs_compiled = ATOMIC_VAR_INIT(0u),
@@ -184,6 +187,9 @@ void rv32emu_jit_stats_reset(void) {
   atomic_store_explicit(&g_rv32emu_jit_stats.helper_cf_calls, 0u, memory_order_relaxed);
   atomic_store_explicit(&g_rv32emu_jit_stats.chain_hits, 0u, memory_order_relaxed);
   atomic_store_explicit(&g_rv32emu_jit_stats.chain_misses, 0u, memory_order_relaxed);
+  atomic_store_explicit(&g_rv32emu_jit_stats.code_invalidations, 0u, memory_order_relaxed);
+  atomic_store_explicit(&g_rv32emu_jit_stats.fence_invalidations, 0u, memory_order_relaxed);
+  atomic_store_explicit(&g_rv32emu_jit_stats.tb_builds, 0u, memory_order_relaxed);
   atomic_store_explicit(&g_rv32emu_jit_stats.async_jobs_enqueued, 0u, memory_order_relaxed);
   atomic_store_explicit(&g_rv32emu_jit_stats.async_jobs_dropped, 0u, memory_order_relaxed);
   atomic_store_explicit(&g_rv32emu_jit_stats.async_jobs_compiled, 0u, memory_order_relaxed);
@@ -225,6 +231,9 @@ void rv32emu_jit_stats_dump(uint64_t executed) {
   uint64_t helper_cf_calls;
   uint64_t chain_hits;
   uint64_t chain_misses;
+  uint64_t code_invalidations;
+  uint64_t fence_invalidations;
+  uint64_t tb_builds;
   uint64_t async_jobs_enqueued;
   uint64_t async_jobs_dropped;
   uint64_t async_jobs_compiled;
@@ -302,6 +311,11 @@ void rv32emu_jit_stats_dump(uint64_t executed) {
   helper_cf_calls = atomic_load_explicit(&g_rv32emu_jit_stats.helper_cf_calls, memory_order_relaxed);
   chain_hits = atomic_load_explicit(&g_rv32emu_jit_stats.chain_hits, memory_order_relaxed);
   chain_misses = atomic_load_explicit(&g_rv32emu_jit_stats.chain_misses, memory_order_relaxed);
+  code_invalidations =
+      atomic_load_explicit(&g_rv32emu_jit_stats.code_invalidations, memory_order_relaxed);
+  fence_invalidations =
+      atomic_load_explicit(&g_rv32emu_jit_stats.fence_invalidations, memory_order_relaxed);
+  tb_builds = atomic_load_explicit(&g_rv32emu_jit_stats.tb_builds, memory_order_relaxed);
   async_jobs_enqueued =
       atomic_load_explicit(&g_rv32emu_jit_stats.async_jobs_enqueued, memory_order_relaxed);
   async_jobs_dropped =
@@ -389,8 +403,10 @@ void rv32emu_jit_stats_dump(uint64_t executed) {
           compile_fail_emit);
   fprintf(stderr,
           "[jit] helpers mem=%" PRIu64 " cf=%" PRIu64 " chain_hits=%" PRIu64
-          " chain_misses=%" PRIu64 "\n",
-          helper_mem_calls, helper_cf_calls, chain_hits, chain_misses);
+          " chain_misses=%" PRIu64 " code_invalidations=%" PRIu64
+          " fence_invalidations=%" PRIu64 " tb_builds=%" PRIu64 "\n",
+          helper_mem_calls, helper_cf_calls, chain_hits, chain_misses, code_invalidations,
+          fence_invalidations, tb_builds);
   fprintf(stderr,
           "[jit] async enqueued=%" PRIu64 " dropped=%" PRIu64 " compiled=%" PRIu64
           " applied=%" PRIu64 " stale=%" PRIu64 " template_applied=%" PRIu64
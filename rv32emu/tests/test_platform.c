@@ -3,21 +3,79 @@
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <time.h>
+
+typedef struct {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t last;
+} test_scratch_dev_t;
+
+static bool test_scratch_read(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                              uint32_t *out) {
+  test_scratch_dev_t *dev = opaque;
+
+  (void)m;
+  (void)paddr;
+  (void)len;
+  dev->reads++;
+  *out = dev->last;
+  return true;
+}
+
+static bool test_scratch_write(rv32emu_machine_t *m, void *opaque, uint32_t paddr, int len,
+                               uint32_t data) {
+  test_scratch_dev_t *dev = opaque;
+
+  (void)m;
+  (void)len;
+  dev->writes++;
+  dev->last = data ^ paddr;
+  return true;
+}
+
+typedef struct {
+  uint32_t count;
+  uint32_t pages[8];
+} test_dirty_log_t;
+
+static void test_dirty_record(void *opaque, uint32_t page_paddr) {
+  test_dirty_log_t *log = opaque;
+
+  if (log->count < 8u) {
+    log->pages[log->count] = page_paddr;
+  }
+  log->count++;
+}
 
 int main(void) {
   rv32emu_machine_t m;
   rv32emu_machine_t smp;
   rv32emu_options_t opts;
+  test_scratch_dev_t scratch = {0};
+  test_dirty_log_t dirty_log = {0};
   uint32_t value = 0;
   uint32_t paddr;
 
   rv32emu_default_options(&opts);
   assert(rv32emu_platform_init(&m, &opts));
 
+  m.plat.dram_atomic_stats_enable = true;
   paddr = RV32EMU_DRAM_BASE + 0x100u;
   assert(rv32emu_phys_write(&m, paddr, 4, 0x11223344u));
   assert(rv32emu_phys_read(&m, paddr, 4, &value));
   assert(value == 0x11223344u);
+  assert(rv32emu_phys_write(&m, paddr + 5u, 2, 0xbeefu));
+  assert(rv32emu_phys_read(&m, paddr + 5u, 2, &value));
+  assert(value == 0xbeefu);
+  assert(rv32emu_phys_read(&m, paddr + 3u, 4, &value));
+  assert(value == 0xbeef0011u);
+  /* Single-threaded DRAM accesses never touch a platform mutex. */
+  assert(m.plat.lock_acquires == 0u);
+  assert(rv32emu_phys_read(&m, RV32EMU_UART_BASE + 5u, 1, &value));
+  assert(m.plat.lock_acquires == 1u);
+  m.plat.dram_atomic_stats_enable = false;
 
   assert(rv32emu_virt_write(&m, paddr, 2, RV32EMU_ACC_STORE, 0xa55au));
   assert(rv32emu_virt_read(&m, paddr, 2, RV32EMU_ACC_LOAD, &value));
@@ -63,6 +121,23 @@ int main(void) {
   rv32emu_step_timer(&m);
   assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) != 0);
 
+  /* Ticks batch per hart; guest-visible reads flush, deadlines end a batch early. */
+  assert(m.opts.timer_batch == RV32EMU_DEFAULT_TIMER_BATCH);
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u, 4, 40u));
+  value = (uint32_t)atomic_load(&m.plat.mtime);
+  for (uint32_t i = 0u; i < 10u; i++) {
+    rv32emu_step_timer(&m);
+  }
+  assert(atomic_load(&m.plat.mtime) < value + 10u);
+  assert(rv32emu_csr_read(&m, CSR_TIME) == value + 10u);
+  assert(atomic_load(&m.plat.mtime) == value + 10u);
+  rv32emu_advance_timer(&m, 40u - value - 11u);
+  assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) == 0);
+  rv32emu_step_timer(&m);
+  assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) != 0);
+  assert(rv32emu_phys_read(&m, RV32EMU_CLINT_BASE + 0xbff8u, 4, &value));
+  assert(value == 40u);
+
   assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x0000u, 4, 1u));
   assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MSIP) != 0);
   assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x0000u, 4, 0u));
@@ -106,6 +181,169 @@ int main(void) {
   assert((rv32emu_cpu_mip_load(rv32emu_hart_cpu(&smp, 1u)) & MIP_MEIP) == 0u);
 
   rv32emu_platform_destroy(&smp);
+
+  /* Physical map: extra devices plug in without touching phys_read/phys_write. */
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(rv32emu_phys_lookup(&m, RV32EMU_DRAM_BASE)->host == m.plat.dram);
+  assert(rv32emu_phys_lookup(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 1u) != NULL);
+  assert(rv32emu_phys_lookup(&m, RV32EMU_DRAM_BASE + m.plat.dram_size) == NULL);
+  assert(rv32emu_phys_lookup(&m, RV32EMU_UART_BASE + 5u)->read != NULL);
+  assert(!rv32emu_phys_read(&m, 0x20000000u, 4, &value));
+  assert(rv32emu_phys_map_device(&m, "scratch", 0x20000000u, 0x1000u, test_scratch_read,
+                                 test_scratch_write, &scratch, NULL));
+  assert(!rv32emu_phys_map_device(&m, "overlap", RV32EMU_UART_BASE, 0x1000u, test_scratch_read,
+                                  test_scratch_write, &scratch, NULL));
+  assert(!rv32emu_phys_map_device(&m, "unaligned", 0x20002004u, 0x100u, test_scratch_read,
+                                  test_scratch_write, &scratch, NULL));
+  assert(rv32emu_phys_write(&m, 0x20000010u, 4, 0x5au));
+  assert(rv32emu_phys_read(&m, 0x20000010u, 4, &value));
+  assert(value == (0x5au ^ 0x20000010u));
+  assert(scratch.reads == 1u && scratch.writes == 1u);
+  assert(!rv32emu_phys_read(&m, 0x20001000u, 4, &value));
+  rv32emu_platform_destroy(&m);
+
+  /* Dirty map: every DRAM write path marks its 4 KiB pages; scans report and clear them. */
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(m.plat.dirty_map == NULL);
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE, m.plat.dram_size, true, NULL, NULL) == 0u);
+  rv32emu_platform_destroy(&m);
+  opts.dirty_tracking = true;
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(m.plat.dirty_map != NULL && m.plat.dirty_pages == m.plat.dram_size >> 12);
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE, m.plat.dram_size, false, NULL, NULL) == 0u);
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x3004u, 4, 1u));
+  assert(rv32emu_virt_write(&m, RV32EMU_DRAM_BASE + 0x9ffeu, 4, RV32EMU_ACC_STORE, 2u));
+  assert(rv32emu_virt_write(&m, RV32EMU_DRAM_BASE + 0x20000u, 1, RV32EMU_ACC_STORE, 3u));
+  assert(rv32emu_virt_amo32(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 4u, RV32EMU_AMO_ADD, 1u,
+                            &value));
+  assert(rv32emu_phys_write(&m, RV32EMU_UART_BASE + 7u, 1, 0x42u));
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE + 0x9000u, 0x1000u, false, NULL, NULL) == 1u);
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE, m.plat.dram_size, true, test_dirty_record,
+                            &dirty_log) == 5u);
+  assert(dirty_log.count == 5u);
+  assert(dirty_log.pages[0] == RV32EMU_DRAM_BASE + 0x3000u);
+  assert(dirty_log.pages[1] == RV32EMU_DRAM_BASE + 0x9000u);
+  assert(dirty_log.pages[2] == RV32EMU_DRAM_BASE + 0xa000u);
+  assert(dirty_log.pages[3] == RV32EMU_DRAM_BASE + 0x20000u);
+  assert(dirty_log.pages[4] == RV32EMU_DRAM_BASE + m.plat.dram_size - 0x1000u);
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE, m.plat.dram_size, false, NULL, NULL) == 0u);
+  /* Partial-range clears leave pages outside the range dirty. */
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x5000u, 4, 1u));
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x6000u, 4, 1u));
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE + 0x5000u, 0x1000u, true, NULL, NULL) == 1u);
+  assert(rv32emu_dirty_scan(&m, RV32EMU_DRAM_BASE, m.plat.dram_size, false, NULL, NULL) == 1u);
+  rv32emu_platform_destroy(&m);
+
+  /* Huge page backings must come up zeroed, or fall back to 4 KiB pages. */
+  rv32emu_default_options(&opts);
+  assert(opts.dram_backing == RV32EMU_DRAM_BACKING_ANON);
+  opts.ram_mb = 1024u;
+  opts.dram_backing = RV32EMU_DRAM_BACKING_THP;
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(m.plat.dram_map_size >= m.plat.dram_size);
+  assert(rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 4u, 4, &value));
+  assert(value == 0u);
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x200000u, 4, 0xcafef00du));
+  assert(rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + 0x200000u, 4, &value));
+  assert(value == 0xcafef00du);
+  rv32emu_platform_destroy(&m);
+
+  opts.ram_mb = 3u;
+  opts.dram_backing = RV32EMU_DRAM_BACKING_HUGETLB;
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(m.plat.dram_backing == RV32EMU_DRAM_BACKING_HUGETLB ||
+         m.plat.dram_backing == RV32EMU_DRAM_BACKING_ANON);
+  assert(m.plat.dram_map_size >= m.plat.dram_size);
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 4u, 4, 0x1u));
+  assert(!rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + m.plat.dram_size, 4, 0x1u));
+  rv32emu_platform_destroy(&m);
+
+  /* Host clock source: mtime follows CLOCK_MONOTONIC, not retired instructions. */
+  rv32emu_default_options(&opts);
+  opts.mtime_source = RV32EMU_MTIME_HOST;
+  opts.timebase_hz = 1u;
+  assert(rv32emu_platform_init(&m, &opts));
+  rv32emu_advance_timer(&m, 100000u);
+  assert(rv32emu_csr_read(&m, CSR_TIME) <= 1u);
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0xbff8u, 4, 5000u));
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0xbffcu, 4, 0u));
+  value = rv32emu_csr_read(&m, CSR_TIME);
+  assert(value >= 5000u && value <= 5001u);
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u, 4, 5000u));
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4004u, 4, 0u));
+  assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) != 0);
+  rv32emu_platform_destroy(&m);
+
+  opts.timebase_hz = 1000000000u;
+  assert(rv32emu_platform_init(&m, &opts));
+  value = rv32emu_csr_read(&m, CSR_TIME);
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u, 4, value + 2000000u));
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4004u, 4, 0u));
+  nanosleep(&(struct timespec){.tv_nsec = 5000000}, NULL);
+  assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) == 0);
+  rv32emu_advance_timer(&m, RV32EMU_HOST_CLOCK_POLL_INSNS);
+  assert((rv32emu_csr_read(&m, CSR_MIP) & MIP_MTIP) != 0);
+  assert(rv32emu_csr_read(&m, CSR_TIME) - value >= 5000000u);
+  rv32emu_platform_destroy(&m);
+
+  /* memfd DRAM is shared: a second mapping of dram_fd sees phys_write stores. */
+  rv32emu_default_options(&opts);
+  opts.dram_backing = RV32EMU_DRAM_BACKING_MEMFD;
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x7008u, 4, 0x13572468u));
+  if (m.plat.dram_backing == RV32EMU_DRAM_BACKING_MEMFD) {
+    uint8_t *view = mmap(NULL, 0x1000u, PROT_READ, MAP_SHARED, m.plat.dram_fd, 0x7000);
+
+    assert(view != MAP_FAILED && view != m.plat.dram + 0x7000u);
+    assert(view[8] == 0x68u && view[11] == 0x13u);
+    assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x700cu, 1, 0x99u));
+    assert(view[12] == 0x99u);
+    assert(munmap(view, 0x1000u) == 0);
+  } else {
+    assert(m.plat.dram_backing == RV32EMU_DRAM_BACKING_ANON && m.plat.dram_fd < 0);
+  }
+  rv32emu_platform_destroy(&m);
+  assert(m.plat.dram_fd < 0);
+
+  opts.flat_phys = true;
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 4u, 4, 0x2u));
+  assert(rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 4u, 4, &value));
+  assert(value == 0x2u);
+  rv32emu_platform_destroy(&m);
+
+  /* The flat window puts DRAM at window + paddr; everything else stays unmapped. */
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(m.plat.phys_window == NULL);
+  assert(rv32emu_dram_page(&m, RV32EMU_DRAM_BASE + 0x3000u) == m.plat.dram + 0x3000u);
+  rv32emu_platform_destroy(&m);
+
+  opts.flat_phys = true;
+  opts.dram_backing = RV32EMU_DRAM_BACKING_THP;
+  assert(rv32emu_platform_init(&m, &opts));
+  if (sizeof(void *) == 8u) {
+    assert(m.plat.phys_window != NULL && m.opts.flat_phys);
+    assert(m.plat.dram == m.plat.phys_window + RV32EMU_DRAM_BASE);
+  }
+  assert(rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + 0x3004u, 4, 0x5a5aa5a5u));
+  assert(rv32emu_dram_page(&m, RV32EMU_DRAM_BASE + 0x3000u) == m.plat.dram + 0x3000u);
+  assert(rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + 0x3004u, 4, &value));
+  assert(value == 0x5a5aa5a5u);
+  assert(rv32emu_dram_page(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 0x1000u) != NULL);
+  assert(rv32emu_dram_page(&m, RV32EMU_DRAM_BASE + m.plat.dram_size) == NULL);
+  assert(rv32emu_dram_page(&m, RV32EMU_UART_BASE) == NULL);
+  assert(rv32emu_phys_read(&m, RV32EMU_UART_BASE + 5u, 1, &value));
+  assert(!rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + m.plat.dram_size - 2u, 4, &value));
+  assert(!rv32emu_phys_write(&m, RV32EMU_DRAM_BASE + m.plat.dram_size, 1, 0u));
+  /* Bare translation goes straight to window + vaddr. */
+  assert(rv32emu_virt_write(&m, RV32EMU_DRAM_BASE + 0x5008u, 4, RV32EMU_ACC_STORE, 0x1234u));
+  assert(rv32emu_virt_read(&m, RV32EMU_DRAM_BASE + 0x5008u, 4, RV32EMU_ACC_LOAD, &value));
+  assert(value == 0x1234u && m.plat.dram[0x5008u] == 0x34u);
+  rv32emu_platform_destroy(&m);
+  assert(m.plat.phys_window == NULL && m.plat.dram == NULL);
   puts("[OK] rv32emu platform test passed");
   return 0;
 }
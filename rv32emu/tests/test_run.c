@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 static uint16_t enc_c_addi(uint32_t rd, int32_t imm6) {
   uint32_t u = (uint32_t)imm6 & 0x3fu;
@@ -127,6 +128,100 @@ static void test_rvc_basic(void) {
   rv32emu_platform_destroy(&m);
 }
 
+static void run_bound_prog(rv32emu_machine_t *m, const uint32_t *prog, uint32_t count,
+                           bool tb) {
+  rv32emu_options_t opts;
+
+  if (tb) {
+    setenv("RV32EMU_EXPERIMENTAL_TB", "1", 1);
+  }
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(m, &opts));
+  for (uint32_t i = 0; i < count; i++) {
+    assert(rv32emu_phys_write(m, RV32EMU_DRAM_BASE + i * 4u, 4, prog[i]));
+  }
+  m->cpu.pc = RV32EMU_DRAM_BASE;
+  /* 5 words skipped, one holds two RVC ops, ebreak traps */
+  assert(rv32emu_run(m, 256) == (int)count - 5);
+  unsetenv("RV32EMU_EXPERIMENTAL_TB");
+}
+
+static void test_tb_bound_handlers(void) {
+  static rv32emu_machine_t interp;
+  static rv32emu_machine_t tb;
+  uint32_t prog[] = {
+      enc_u(0x37u, 10u, 0x80001u),              /* lui   x10, 0x80001 */
+      enc_i(0x13u, 1u, 0x0u, 0u, -7),           /* addi  x1, x0, -7 */
+      enc_i(0x13u, 2u, 0x0u, 0u, 12),           /* addi  x2, x0, 12 */
+      enc_i(0x13u, 3u, 0x2u, 1u, 0),            /* slti  x3, x1, 0 */
+      enc_i(0x13u, 4u, 0x3u, 1u, 1),            /* sltiu x4, x1, 1 */
+      enc_i(0x13u, 5u, 0x4u, 1u, 0x55),         /* xori  x5, x1, 0x55 */
+      enc_i(0x13u, 6u, 0x6u, 2u, 0x300),        /* ori   x6, x2, 0x300 */
+      enc_i(0x13u, 7u, 0x7u, 1u, 0xf0),         /* andi  x7, x1, 0xf0 */
+      enc_i_shift(8u, 0x1u, 1u, 3u, 0x00u),     /* slli  x8, x1, 3 */
+      enc_i_shift(9u, 0x5u, 1u, 4u, 0x00u),     /* srli  x9, x1, 4 */
+      enc_i_shift(11u, 0x5u, 1u, 2u, 0x20u),    /* srai  x11, x1, 2 */
+      enc_r(0x33u, 12u, 0x0u, 1u, 2u, 0x00u),   /* add   x12, x1, x2 */
+      enc_r(0x33u, 13u, 0x0u, 1u, 2u, 0x20u),   /* sub   x13, x1, x2 */
+      enc_r(0x33u, 14u, 0x1u, 2u, 2u, 0x00u),   /* sll   x14, x2, x2 */
+      enc_r(0x33u, 15u, 0x2u, 1u, 2u, 0x00u),   /* slt   x15, x1, x2 */
+      enc_r(0x33u, 16u, 0x3u, 1u, 2u, 0x00u),   /* sltu  x16, x1, x2 */
+      enc_r(0x33u, 17u, 0x4u, 1u, 2u, 0x00u),   /* xor   x17, x1, x2 */
+      enc_r(0x33u, 18u, 0x5u, 1u, 2u, 0x00u),   /* srl   x18, x1, x2 */
+      enc_r(0x33u, 19u, 0x5u, 1u, 2u, 0x20u),   /* sra   x19, x1, x2 */
+      enc_r(0x33u, 20u, 0x6u, 1u, 2u, 0x00u),   /* or    x20, x1, x2 */
+      enc_r(0x33u, 21u, 0x7u, 1u, 2u, 0x00u),   /* and   x21, x1, x2 */
+      enc_i(0x13u, 0u, 0x0u, 1u, 1),            /* addi  x0, x1, 1 */
+      enc_u(0x17u, 22u, 0x12u),                 /* auipc x22, 0x12 */
+      enc_s(0x23u, 0x2u, 10u, 1u, 0),           /* sw    x1, 0(x10) */
+      enc_s(0x23u, 0x1u, 10u, 2u, 4),           /* sh    x2, 4(x10) */
+      enc_s(0x23u, 0x0u, 10u, 1u, 6),           /* sb    x1, 6(x10) */
+      enc_i(0x03u, 23u, 0x2u, 10u, 0),          /* lw    x23, 0(x10) */
+      enc_i(0x03u, 24u, 0x1u, 10u, 0),          /* lh    x24, 0(x10) */
+      enc_i(0x03u, 25u, 0x5u, 10u, 0),          /* lhu   x25, 0(x10) */
+      enc_i(0x03u, 26u, 0x0u, 10u, 6),          /* lb    x26, 6(x10) */
+      enc_i(0x03u, 27u, 0x4u, 10u, 6),          /* lbu   x27, 6(x10) */
+      enc_b(0x63u, 0x0u, 1u, 1u, 8),            /* beq   x1, x1, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 1),          /* (skipped) */
+      enc_b(0x63u, 0x1u, 1u, 1u, 8),            /* bne   x1, x1, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 2),          /* addi  x28, x28, 2 */
+      enc_b(0x63u, 0x4u, 1u, 2u, 8),            /* blt   x1, x2, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 4),          /* (skipped) */
+      enc_b(0x63u, 0x5u, 1u, 2u, 8),            /* bge   x1, x2, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 8),          /* addi  x28, x28, 8 */
+      enc_b(0x63u, 0x6u, 1u, 2u, 8),            /* bltu  x1, x2, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 16),         /* addi  x28, x28, 16 */
+      enc_b(0x63u, 0x7u, 1u, 2u, 8),            /* bgeu  x1, x2, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 32),         /* (skipped) */
+      0x00800eefu,                              /* jal   x29, +8 */
+      enc_i(0x13u, 28u, 0x0u, 28u, 64),         /* (skipped) */
+      enc_u(0x17u, 30u, 0u),                    /* auipc x30, 0 */
+      enc_i(0x67u, 31u, 0x0u, 30u, 12),         /* jalr  x31, 12(x30) */
+      enc_i(0x13u, 28u, 0x0u, 28u, 128),        /* (skipped) */
+      (uint32_t)enc_c_addi(28u, 1) | ((uint32_t)enc_c_mv(6u, 28u) << 16), /* c.addi; c.mv */
+      enc_r(0x33u, 5u, 0x0u, 1u, 2u, 0x01u),    /* mul   x5, x1, x2 (generic) */
+      0x00100073u,                              /* ebreak */
+  };
+  uint32_t count = (uint32_t)(sizeof(prog) / sizeof(prog[0]));
+
+  /* Bound handlers retire exactly like the full decoder; only RV32I ops get their own. */
+  assert(rv32emu_exec_bind(&(rv32emu_decoded_insn_t){.opcode = 0x33u, .funct7 = 0x01u}) ==
+         rv32emu_exec_bind(&(rv32emu_decoded_insn_t){.opcode = 0x73u}));
+  assert(rv32emu_exec_bind(&(rv32emu_decoded_insn_t){.opcode = 0x13u}) !=
+         rv32emu_exec_bind(&(rv32emu_decoded_insn_t){.opcode = 0x73u}));
+
+  run_bound_prog(&interp, prog, count, false);
+  run_bound_prog(&tb, prog, count, true);
+  assert(memcmp(interp.cpu.x, tb.cpu.x, sizeof(interp.cpu.x)) == 0);
+  assert(interp.cpu.pc == tb.cpu.pc && interp.cpu.instret == tb.cpu.instret);
+  assert(atomic_load(&interp.plat.mtime) == atomic_load(&tb.plat.mtime));
+  assert(memcmp(interp.plat.dram + 0x1000u, tb.plat.dram + 0x1000u, 8u) == 0);
+  assert(tb.cpu.x[0] == 0u && tb.cpu.x[28] == 27u && tb.cpu.x[6] == 27u);
+  assert(tb.cpu.x[5] == (uint32_t)-84 && tb.cpu.x[26] == (uint32_t)-7);
+  rv32emu_platform_destroy(&interp);
+  rv32emu_platform_destroy(&tb);
+}
+
 static void test_multihart_round_robin(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -226,12 +321,269 @@ static void test_multihart_lr_sc_invalidation(void) {
   steps = rv32emu_run(&m, 256);
   assert(steps >= 67);
   assert(m.harts[0].x[6] == 1u); /* sc.w must fail after hart1 store */
+  assert(m.plat.lr_live == 0u);
   assert(rv32emu_phys_read(&m, shared_addr, 4, &value));
   assert(value == 0x12345678u);
 
   rv32emu_platform_destroy(&m);
 }
 
+static void test_threaded_mmio_per_device_locks(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc;
+  uint32_t prog[] = {
+      enc_s(0x23u, 0x2u, 2u, 3u, 0),        /* sw x3, 0(x2) -> own mtimecmp lo */
+      enc_s(0x23u, 0x2u, 2u, 0u, 4),        /* sw x0, 4(x2) -> own mtimecmp hi */
+      enc_i(0x03u, 5u, 0x2u, 1u, 0xff8),    /* lw x5, 0xff8(x1) -> mtime */
+      enc_s(0x23u, 0x0u, 4u, 3u, 7),        /* sb x3, 7(x4) -> UART scratch */
+      enc_i(0x03u, 6u, 0x2u, 7u, 0),        /* lw x6, 0(x7) -> PLIC pending */
+      0x00100073u,                          /* ebreak */
+  };
+  int steps;
+
+  rv32emu_default_options(&opts);
+  opts.hart_count = 4u;
+  assert(rv32emu_platform_init(&m, &opts));
+
+  pc = RV32EMU_DRAM_BASE + 0x200u;
+  for (uint32_t i = 0; i < (uint32_t)(sizeof(prog) / sizeof(prog[0])); i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  for (uint32_t hart = 0u; hart < 4u; hart++) {
+    m.harts[hart].pc = pc;
+    m.harts[hart].running = true;
+    m.harts[hart].csr[CSR_MHARTID] = hart;
+    m.harts[hart].x[1] = RV32EMU_CLINT_BASE + 0xb000u;
+    m.harts[hart].x[2] = RV32EMU_CLINT_BASE + 0x4000u + hart * 8u;
+    m.harts[hart].x[3] = 1000u + hart * 100u;
+    m.harts[hart].x[4] = RV32EMU_UART_BASE;
+    m.harts[hart].x[7] = RV32EMU_PLIC_BASE + 0x1000u;
+  }
+
+  /* UART, PLIC and each hart's CLINT slice lock independently across worker threads. */
+  setenv("RV32EMU_EXPERIMENTAL_HART_THREADS", "1", 1);
+  steps = rv32emu_run(&m, 64);
+  unsetenv("RV32EMU_EXPERIMENTAL_HART_THREADS");
+  assert(steps == 20);
+
+  for (uint32_t hart = 0u; hart < 4u; hart++) {
+    assert(m.harts[hart].running == false);
+    assert(m.harts[hart].csr[CSR_MCAUSE] == RV32EMU_EXC_BREAKPOINT);
+    assert(rv32emu_clint_mtimecmp(&m, hart) == 1000u + hart * 100u);
+  }
+  assert(m.plat.next_timer_deadline == 1000u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_threaded_amo_counter(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc;
+  uint32_t counter = RV32EMU_DRAM_BASE + 0x1000u;
+  uint32_t prog[] = {
+      enc_r(0x2fu, 0u, 0x2u, 1u, 3u, 0x00u), /* amoadd.w x0, x3, (x1) */
+      enc_i(0x13u, 2u, 0x0u, 2u, -1),        /* addi x2, x2, -1 */
+      enc_b(0x63u, 0x1u, 2u, 0u, -8),        /* bne x2, x0, -8 */
+      0x00100073u,                           /* ebreak */
+  };
+  uint32_t value = 0u;
+  int steps;
+
+  rv32emu_default_options(&opts);
+  opts.hart_count = 4u;
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+
+  pc = RV32EMU_DRAM_BASE + 0x200u;
+  for (uint32_t i = 0; i < (uint32_t)(sizeof(prog) / sizeof(prog[0])); i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  for (uint32_t hart = 0u; hart < 4u; hart++) {
+    m.harts[hart].pc = pc;
+    m.harts[hart].running = true;
+    m.harts[hart].csr[CSR_MHARTID] = hart;
+    m.harts[hart].x[1] = counter;
+    m.harts[hart].x[2] = 500u;
+    m.harts[hart].x[3] = 1u;
+  }
+
+  /* Concurrent amoadd.w on one DRAM word: no lost updates, no amo_lock traffic. */
+  setenv("RV32EMU_EXPERIMENTAL_HART_THREADS", "1", 1);
+  steps = rv32emu_run(&m, 100000);
+  unsetenv("RV32EMU_EXPERIMENTAL_HART_THREADS");
+  assert(steps == 4 * 500 * 3);
+
+  assert(rv32emu_phys_read(&m, counter, 4, &value));
+  assert(value == 4u * 500u);
+  for (uint32_t hart = 0u; hart < 4u; hart++) {
+    assert(m.harts[hart].csr[CSR_MCAUSE] == RV32EMU_EXC_BREAKPOINT);
+  }
+  assert(m.plat.lock_acquires == 0u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_wfi_parks_on_host_clock(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc = RV32EMU_DRAM_BASE + 0x200u;
+  uint32_t prog[] = {
+      0x10500073u,                        /* wfi */
+      enc_i(0x13u, 1u, 0x0u, 0u, 1),      /* addi x1, x0, 1 */
+      0x00100073u,                        /* ebreak */
+      enc_s(0x23u, 0x2u, 2u, 3u, 4),      /* sw x3, 4(x2) -> msip[1] */
+      0x00100073u,                        /* ebreak */
+  };
+  uint32_t now;
+  int steps;
+
+  rv32emu_default_options(&opts);
+  opts.mtime_source = RV32EMU_MTIME_HOST;
+  opts.timebase_hz = 1000000000u;
+  opts.hart_count = 2u;
+  assert(rv32emu_platform_init(&m, &opts));
+  for (uint32_t i = 0; i < (uint32_t)(sizeof(prog) / sizeof(prog[0])); i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  /* Single thread: the idle hart sleeps until its timer deadline, then resumes after wfi. */
+  now = rv32emu_csr_read(&m, CSR_TIME);
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u, 4, now + 3000000u));
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4004u, 4, 0u));
+  m.harts[0].pc = pc;
+  m.harts[0].csr[CSR_MIE] = MIP_MTIP;
+  steps = rv32emu_run(&m, 16);
+  assert(steps == 2);
+  assert(m.harts[0].x[1] == 1u && !m.harts[0].wfi_idle);
+  assert(rv32emu_csr_read(&m, CSR_TIME) >= now + 3000000u);
+
+  /* Worker threads: hart 1 parks until hart 0's MSIP store wakes it. */
+  m.harts[0].pc = pc + 12u;
+  m.harts[0].running = true;
+  m.harts[0].x[2] = RV32EMU_CLINT_BASE;
+  m.harts[0].x[3] = 1u;
+  m.harts[1].pc = pc;
+  m.harts[1].running = true;
+  m.harts[1].csr[CSR_MHARTID] = 1u;
+  m.harts[1].csr[CSR_MIE] = MIP_MSIP;
+  setenv("RV32EMU_EXPERIMENTAL_HART_THREADS", "1", 1);
+  steps = rv32emu_run(&m, 16);
+  unsetenv("RV32EMU_EXPERIMENTAL_HART_THREADS");
+  assert(steps == 3);
+  assert(m.harts[1].x[1] == 1u);
+  assert(m.harts[1].csr[CSR_MCAUSE] == RV32EMU_EXC_BREAKPOINT);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_wfi_idle_fast_forward(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc = RV32EMU_DRAM_BASE + 0x200u;
+  uint32_t prog[] = {
+      0x10500073u,                        /* wfi */
+      enc_i(0x13u, 1u, 0x0u, 0u, 1),      /* addi x1, x0, 1 */
+      0x00100073u,                        /* ebreak */
+  };
+  int steps;
+
+  rv32emu_default_options(&opts);
+  opts.hart_count = 2u;
+  assert(rv32emu_platform_init(&m, &opts));
+  for (uint32_t i = 0; i < (uint32_t)(sizeof(prog) / sizeof(prog[0])); i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  /* Instret time: with every hart idle, mtime jumps to the next deadline at once. */
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u, 4, 1000000u));
+  assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4004u, 4, 0u));
+  m.harts[0].pc = pc;
+  m.harts[0].csr[CSR_MIE] = MIP_MTIP;
+  steps = rv32emu_run(&m, 16);
+  assert(steps == 2);
+  assert(m.harts[0].x[1] == 1u);
+  assert(atomic_load(&m.plat.mtime) >= 1000000u && atomic_load(&m.plat.mtime) < 1000016u);
+  assert(m.plat.idle_warps == 1u && m.plat.idle_warp_ticks <= 1000000u);
+
+  /* Worker threads: the last hart to go idle warps; each wakes at its own deadline. */
+  for (uint32_t hart = 0u; hart < 2u; hart++) {
+    m.harts[hart].pc = pc;
+    m.harts[hart].running = true;
+    m.harts[hart].x[1] = 0u;
+    m.harts[hart].csr[CSR_MHARTID] = hart;
+    m.harts[hart].csr[CSR_MIE] = MIP_MTIP;
+    assert(rv32emu_phys_write(&m, RV32EMU_CLINT_BASE + 0x4000u + hart * 8u, 4,
+                              2000000u + hart * 500000u));
+  }
+  setenv("RV32EMU_EXPERIMENTAL_HART_THREADS", "1", 1);
+  steps = rv32emu_run(&m, 64);
+  unsetenv("RV32EMU_EXPERIMENTAL_HART_THREADS");
+  assert(steps == 4);
+  assert(m.harts[0].x[1] == 1u && m.harts[1].x[1] == 1u);
+  assert(atomic_load(&m.plat.mtime) >= 2500000u);
+
+  /* No deadline ahead: wfi falls back to a no-op and the budget runs out. */
+  m.harts[0].pc = pc;
+  m.harts[0].running = true;
+  m.harts[0].csr[CSR_MIE] = MIP_MSIP;
+  m.harts[1].running = false;
+  prog[1] = 0xffdff06fu; /* j -4 */
+  assert(rv32emu_phys_write(&m, pc + 4u, 4, prog[1]));
+  steps = rv32emu_run(&m, 100);
+  assert(steps == 100);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_tb_spin_loop_warp(bool jit) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc = RV32EMU_DRAM_BASE + 0x200u;
+  uint32_t prog[] = {
+      enc_csr(0x2u, 5u, 0u, CSR_TIME),        /* csrr x5, time */
+      enc_u(0x37u, 6u, 0x100u),               /* lui  x6, 0x100 (1M ticks) */
+      enc_csr(0x2u, 7u, 0u, CSR_TIME),        /* 1: csrr x7, time */
+      enc_r(0x33u, 7u, 0x0u, 7u, 5u, 0x20u),  /* sub  x7, x7, x5 */
+      enc_b(0x63u, 0x6u, 7u, 6u, -8),         /* bltu x7, x6, 1b */
+      enc_u(0x37u, 10u, 0x200cu),             /* lui  x10, 0x200c */
+      enc_i(0x03u, 7u, 0x2u, 10u, -8),        /* 2: lw x7, -8(x10) (mtime) */
+      enc_b(0x63u, 0x6u, 7u, 8u, -4),         /* bltu x7, x8, 2b */
+      enc_i(0x13u, 1u, 0x0u, 0u, 1),          /* addi x1, x0, 1 */
+      0x00100073u,                            /* ebreak */
+  };
+  int steps;
+
+  setenv("RV32EMU_EXPERIMENTAL_TB", "1", 1);
+  if (jit) {
+    setenv("RV32EMU_EXPERIMENTAL_JIT", "1", 1);
+    setenv("RV32EMU_EXPERIMENTAL_JIT_HOT", "1", 1);
+  }
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  for (uint32_t i = 0; i < (uint32_t)(sizeof(prog) / sizeof(prog[0])); i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  /* A 1M-tick rdtime delay, then polling CLINT mtime up to 3M, in far fewer steps. */
+  m.harts[0].pc = pc;
+  m.harts[0].x[8] = 3000000u;
+  steps = rv32emu_run(&m, 200000);
+  assert(steps > 0 && steps < 20000);
+  assert(m.harts[0].x[1] == 1u);
+  assert(atomic_load(&m.plat.mtime) >= 3000000u && atomic_load(&m.plat.mtime) < 3100000u);
+  assert(m.plat.spin_warps != 0u && m.plat.spin_warp_ticks > 2900000u);
+  assert(m.plat.idle_warps == 0u);
+
+  rv32emu_platform_destroy(&m);
+  unsetenv("RV32EMU_EXPERIMENTAL_TB");
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT");
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT_HOT");
+}
+
 static void test_jit_int_alu(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -745,6 +1097,223 @@ static void test_jit_chain_branch_side_exit_recovery(void) {
   unsetenv("RV32EMU_EXPERIMENTAL_JIT");
 }
 
+static void test_self_modifying_code(const char *mode) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t pc;
+  uint32_t prog[8];
+  uint32_t n = 0u;
+  int steps;
+
+  unsetenv("RV32EMU_EXPERIMENTAL_TB");
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT");
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT_HOT");
+  if (mode != NULL) {
+    setenv(mode, "1", 1);
+    if (strcmp(mode, "RV32EMU_EXPERIMENTAL_JIT") == 0) {
+      setenv("RV32EMU_EXPERIMENTAL_JIT_HOT", "1", 1);
+    }
+  }
+
+  /* Each pass bumps the immediate of the addi two slots ahead, inside the same block. */
+  prog[n++] = enc_r(0x33u, 10u, 0x0u, 10u, 12u, 0x00u); /* add  x10,x10,x12 */
+  prog[n++] = enc_s(0x23u, 0x2u, 11u, 10u, 0);          /* sw   x10,0(x11) */
+  prog[n++] = enc_i(0x13u, 9u, 0x0u, 9u, 0);            /* addi x9,x9,0 (patched) */
+  prog[n++] = enc_i(0x13u, 8u, 0x0u, 8u, -1);           /* addi x8,x8,-1 */
+  prog[n++] = enc_b(0x63u, 0x1u, 8u, 0u, -16);          /* bne  x8,x0,-16 */
+  prog[n++] = 0x00100073u;                               /* ebreak */
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+
+  pc = RV32EMU_DRAM_BASE + 0xe00u;
+  m.cpu.pc = pc;
+  for (uint32_t i = 0u; i < n; i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+  m.cpu.x[8] = 8u;
+  m.cpu.x[10] = prog[2];
+  m.cpu.x[11] = pc + 8u;
+  m.cpu.x[12] = 1u << 20;
+
+  steps = rv32emu_run(&m, 256u);
+  assert(steps == 40);
+  assert(m.cpu.x[9] == 36u);
+  assert(m.cpu.running == false);
+  assert(m.cpu.csr[CSR_MCAUSE] == RV32EMU_EXC_BREAKPOINT);
+
+  rv32emu_platform_destroy(&m);
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT_HOT");
+  unsetenv("RV32EMU_EXPERIMENTAL_JIT");
+  unsetenv("RV32EMU_EXPERIMENTAL_TB");
+}
+
+static void test_tb_fence_flush(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  rv32emu_tb_cache_t cache;
+  rv32emu_tb_block_result_t result;
+  uint32_t pc;
+  uint32_t prog[3];
+  uint32_t patched;
+
+  prog[0] = 0x0000100fu;                   /* fence.i */
+  prog[1] = enc_i(0x13u, 9u, 0x0u, 9u, 1); /* addi x9,x9,1 */
+  prog[2] = 0x00100073u;                   /* ebreak */
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+
+  pc = RV32EMU_DRAM_BASE + 0xf00u;
+  for (uint32_t i = 0u; i < 3u; i++) {
+    assert(rv32emu_phys_write(&m, pc + i * 4u, 4, prog[i]));
+  }
+
+  rv32emu_tb_cache_reset(&cache);
+  m.cpu.pc = pc + 4u;
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 1u);
+
+  /* A write that bypasses the store path (like device DMA) leaves the line stale... */
+  patched = enc_i(0x13u, 9u, 0x0u, 9u, 16);
+  memcpy(m.plat.dram + (pc + 4u - RV32EMU_DRAM_BASE), &patched, sizeof(patched));
+  m.cpu.pc = pc + 4u;
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 2u);
+
+  /* ...until fence.i drops the hart's translated code. */
+  m.cpu.pc = pc;
+  result = rv32emu_exec_tb_block(&m, &cache, 2u);
+  assert(result.retired == 2u && m.cpu.x[9] == 18u);
+  assert(m.cpu.tb_fence == 0u);
+
+  /* A page fence only drops lines on its own page. */
+  patched = enc_i(0x13u, 9u, 0x0u, 9u, 100);
+  memcpy(m.plat.dram + (pc + 4u - RV32EMU_DRAM_BASE), &patched, sizeof(patched));
+  rv32emu_fence_post(&m.cpu.tb_fence, ((pc + 0x1000u) & ~0xfffu) | RV32EMU_FENCE_PAGE);
+  m.cpu.pc = pc + 4u;
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 34u);
+  rv32emu_fence_post(&m.cpu.tb_fence, (pc & ~0xfffu) | RV32EMU_FENCE_PAGE);
+  m.cpu.pc = pc + 4u;
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 134u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static uint32_t count_tb_lines(const rv32emu_tb_cache_t *cache, uint32_t pc) {
+  uint32_t n = 0u;
+
+  for (uint32_t i = 0u; i < RV32EMU_TB_TOTAL_LINES; i++) {
+    if (cache->lines[i].valid && cache->lines[i].start_pc == pc) {
+      n++;
+    }
+  }
+  return n;
+}
+
+static void test_tb_asid_contexts(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  rv32emu_tb_cache_t cache;
+  rv32emu_tb_block_result_t result;
+  uint32_t va = 0x40000000u;
+  uint32_t satp[2];
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+
+  /* Two address spaces (ASID 1 and 2) map the same va to different code. */
+  for (uint32_t i = 0u; i < 2u; i++) {
+    uint32_t root = RV32EMU_DRAM_BASE + 0x10000u + i * 0x3000u;
+    uint32_t l0 = root + 0x1000u;
+    uint32_t code = root + 0x2000u;
+
+    assert(rv32emu_phys_write(&m, root + ((va >> 22) << 2), 4, ((l0 >> 12) << 10) | 0x1u));
+    assert(rv32emu_phys_write(&m, l0, 4, ((code >> 12) << 10) | 0x4bu)); /* V|R|X|A */
+    assert(rv32emu_phys_write(&m, code, 4, enc_i(0x13u, 9u, 0x0u, 9u, i == 0u ? 1 : 100)));
+    assert(rv32emu_phys_write(&m, code + 4u, 4, 0x00100073u));
+    satp[i] = (1u << 31) | ((i + 1u) << 22) | (root >> 12);
+  }
+
+  rv32emu_tb_cache_reset(&cache);
+  m.cpu.priv = RV32EMU_PRIV_S;
+  for (uint32_t round = 0u; round < 2u; round++) {
+    for (uint32_t i = 0u; i < 2u; i++) {
+      m.cpu.csr[CSR_SATP] = satp[i];
+      rv32emu_tlb_flush(&m, &m.cpu);
+      m.cpu.x[9] = 0u;
+      m.cpu.pc = va;
+      result = rv32emu_exec_tb_block(&m, &cache, 1u);
+      assert(result.retired == 1u && m.cpu.x[9] == (i == 0u ? 1u : 100u));
+    }
+  }
+  /* Both contexts keep their own line across the switches. */
+  assert(count_tb_lines(&cache, va) == 2u);
+
+  /* sfence.vma x0, asid only drops that ASID's lines. */
+  rv32emu_fence_post(&m.cpu.tb_fence, (1u << 12) | RV32EMU_FENCE_ASID);
+  m.cpu.x[9] = 0u;
+  m.cpu.pc = va;
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 100u);
+  assert(count_tb_lines(&cache, va) == 1u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_tb_build_page_boundary(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  rv32emu_tb_cache_t cache;
+  rv32emu_tb_block_result_t result;
+  uint32_t root = RV32EMU_DRAM_BASE + 0x10000u;
+  uint32_t l0 = root + 0x1000u;
+  uint32_t code = root + 0x2000u; /* two physical pages */
+  uint32_t va = 0x40000000u;
+  uint32_t pte_b = 0u;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+
+  /* The line starting at va + 0xff8 runs into page B, whose PTE has A clear. */
+  assert(rv32emu_phys_write(&m, root + ((va >> 22) << 2), 4, ((l0 >> 12) << 10) | 0x1u));
+  assert(rv32emu_phys_write(&m, l0, 4, ((code >> 12) << 10) | 0x4bu)); /* V|R|X|A */
+  assert(rv32emu_phys_write(&m, l0 + 4u, 4, (((code + 0x1000u) >> 12) << 10) | 0x0bu));
+  assert(rv32emu_phys_write(&m, code + 0xff8u, 4, enc_i(0x13u, 9u, 0x0u, 9u, 1)));
+  assert(rv32emu_phys_write(&m, code + 0xffcu, 4, enc_i(0x13u, 9u, 0x0u, 9u, 1)));
+  assert(rv32emu_phys_write(&m, code + 0x1000u, 4, enc_i(0x13u, 9u, 0x0u, 9u, 1)));
+  assert(rv32emu_phys_write(&m, code + 0x1004u, 4, 0x00100073u));
+
+  rv32emu_tb_cache_reset(&cache);
+  m.cpu.priv = RV32EMU_PRIV_S;
+  m.cpu.csr[CSR_SATP] = (1u << 31) | (root >> 12);
+  m.cpu.csr[CSR_MTVEC] = RV32EMU_DRAM_BASE + 0x100u;
+  m.cpu.pc = va + 0xff8u;
+
+  /* Building the line must not touch page B's A bit; executing into it does. */
+  result = rv32emu_exec_tb_block(&m, &cache, 2u);
+  assert(result.retired == 2u && m.cpu.x[9] == 2u && m.cpu.pc == va + 0x1000u);
+  assert(rv32emu_phys_read(&m, l0 + 4u, 4, &pte_b) && (pte_b & 0x40u) == 0u);
+  result = rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(result.retired == 1u && m.cpu.x[9] == 3u);
+  assert(rv32emu_phys_read(&m, l0 + 4u, 4, &pte_b) && (pte_b & 0x40u) != 0u);
+
+  /* With page B unmapped, the build still succeeds; the fault comes when pc gets there. */
+  assert(rv32emu_phys_write(&m, l0 + 4u, 4, 0u));
+  rv32emu_tlb_flush(&m, &m.cpu);
+  rv32emu_fence_post(&m.cpu.tb_fence, RV32EMU_FENCE_ALL);
+  m.cpu.pc = va + 0xff8u;
+  result = rv32emu_exec_tb_block(&m, &cache, 2u);
+  assert(result.retired == 2u && m.cpu.x[9] == 5u && m.cpu.csr[CSR_MCAUSE] == 0u);
+  (void)rv32emu_exec_tb_block(&m, &cache, 1u);
+  assert(m.cpu.csr[CSR_MCAUSE] == RV32EMU_EXC_INST_PAGE_FAULT);
+  assert(m.cpu.csr[CSR_MEPC] == va + 0x1000u && m.cpu.csr[CSR_MTVAL] == va + 0x1000u);
+
+  rv32emu_platform_destroy(&m);
+}
+
 static void test_jit_multi_trap_resume_consistency(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -866,8 +1435,21 @@ int main(void) {
 
   test_base32();
   test_rvc_basic();
+  test_tb_bound_handlers();
   test_multihart_round_robin();
   test_multihart_lr_sc_invalidation();
+  test_threaded_mmio_per_device_locks();
+  test_threaded_amo_counter();
+  test_self_modifying_code(NULL);
+  test_self_modifying_code("RV32EMU_EXPERIMENTAL_TB");
+  test_self_modifying_code("RV32EMU_EXPERIMENTAL_JIT");
+  test_tb_fence_flush();
+  test_tb_asid_contexts();
+  test_tb_build_page_boundary();
+  test_wfi_parks_on_host_clock();
+  test_wfi_idle_fast_forward();
+  test_tb_spin_loop_warp(false);
+  test_tb_spin_loop_warp(true);
   test_jit_int_alu();
   test_jit_budget_respected();
   test_jit_load_store_basic();
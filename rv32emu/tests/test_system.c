@@ -1,14 +1,18 @@
 #include "rv32emu.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #define SBI_EXT_LEGACY_SET_TIMER 0x00u
 #define SBI_EXT_LEGACY_SHUTDOWN 0x08u
 #define SBI_EXT_BASE 0x10u
 #define SBI_EXT_TIME 0x54494d45u
 #define SBI_EXT_HSM 0x48534du
+#define SBI_EXT_RFENCE 0x52464e43u
 #define SATP_MODE_SV32 (1u << 31)
 #define SATP_PPN_MASK 0x003fffffu
 
@@ -117,7 +121,7 @@ static void test_sbi_shim_handle_and_ecall(void) {
   m.cpu.x[10] = 120u;
   m.cpu.x[11] = 0u;
   assert(rv32emu_handle_sbi_ecall(&m));
-  assert(m.plat.clint_mtimecmp[0] == 120u);
+  assert(rv32emu_clint_mtimecmp(&m, 0u) == 120u);
   assert((rv32emu_cpu_mip_load(&m.cpu) & (MIP_STIP | MIP_MTIP)) == 0u);
   for (uint32_t i = 0; i < 20; i++) {
     rv32emu_step_timer(&m);
@@ -129,7 +133,7 @@ static void test_sbi_shim_handle_and_ecall(void) {
   m.cpu.x[10] = 140u;
   m.cpu.x[11] = 0u;
   assert(rv32emu_handle_sbi_ecall(&m));
-  assert(m.plat.clint_mtimecmp[0] == 140u);
+  assert(rv32emu_clint_mtimecmp(&m, 0u) == 140u);
   assert(m.cpu.x[10] == 0u);
 
   m.cpu.running = true;
@@ -209,6 +213,131 @@ static void test_sbi_hsm_start_status(void) {
   rv32emu_platform_destroy(&m);
 }
 
+static void test_sbi_remote_fence(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+
+  rv32emu_default_options(&opts);
+  opts.enable_sbi_shim = true;
+  opts.hart_count = 2u;
+  assert(rv32emu_platform_init(&m, &opts));
+  m.cpu.priv = RV32EMU_PRIV_S;
+
+  m.cpu.x[17] = SBI_EXT_RFENCE;
+  m.cpu.x[16] = 1u; /* remote_sfence_vma */
+  m.cpu.x[10] = 0x2u;
+  m.cpu.x[11] = 0u;
+  m.cpu.x[12] = 0x40005010u;
+  m.cpu.x[13] = 0x20u;
+  assert(rv32emu_handle_sbi_ecall(&m));
+  assert(m.cpu.x[10] == 0u);
+  assert(m.cpu.tlb_fence == 0u && m.cpu.tb_fence == 0u);
+  assert(m.harts[1].tlb_fence == (0x40005000u | RV32EMU_FENCE_PAGE));
+  assert(m.harts[1].tb_fence == (0x40005000u | RV32EMU_FENCE_PAGE));
+
+  /* A second page cannot share the request word and widens it to a full flush. */
+  m.cpu.x[17] = SBI_EXT_RFENCE;
+  m.cpu.x[16] = 1u;
+  m.cpu.x[10] = 0x2u;
+  m.cpu.x[11] = 0u;
+  m.cpu.x[12] = 0x40006000u;
+  m.cpu.x[13] = 0x1000u;
+  assert(rv32emu_handle_sbi_ecall(&m));
+  assert(m.harts[1].tlb_fence == RV32EMU_FENCE_ALL);
+
+  m.cpu.x[17] = SBI_EXT_RFENCE;
+  m.cpu.x[16] = 0u; /* remote_fence_i, hart_mask_base -1: all harts */
+  m.cpu.x[10] = 0u;
+  m.cpu.x[11] = UINT32_MAX;
+  assert(rv32emu_handle_sbi_ecall(&m));
+  assert(m.cpu.x[10] == 0u);
+  assert(m.cpu.tlb_fence == 0u && m.cpu.tb_fence == RV32EMU_FENCE_ALL);
+
+  m.cpu.x[17] = SBI_EXT_RFENCE;
+  m.cpu.x[16] = 3u; /* remote_hfence_gvma_vmid */
+  assert(rv32emu_handle_sbi_ecall(&m));
+  assert((int32_t)m.cpu.x[10] == -2);
+
+  /* The target applies its TLB fence at the next interrupt check. */
+  rv32emu_set_active_hart(&m, 1u);
+  (void)rv32emu_check_pending_interrupt(&m);
+  assert(m.harts[1].tlb_fence == 0u);
+  rv32emu_set_active_hart(&m, 0u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void *run_machine_thread(void *opaque) {
+  (void)rv32emu_run((rv32emu_machine_t *)opaque, UINT32_MAX);
+  return NULL;
+}
+
+static void test_sbi_remote_fence_threaded(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  pthread_t runner;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x10000u;
+  const uint32_t l0 = root + 0x1000u;
+  const uint32_t code = root + 0x2000u;
+  const uint32_t data = root + 0x3000u;
+  const uint32_t va = 0x40000000u;
+  uint32_t index;
+  uint32_t flag = 0u;
+
+  rv32emu_default_options(&opts);
+  opts.enable_sbi_shim = true;
+  opts.hart_count = 2u;
+  assert(rv32emu_platform_init(&m, &opts));
+
+  assert(rv32emu_phys_write(&m, root + ((va >> 22) << 2), 4, ((l0 >> 12) << 10) | 0x1u));
+  assert(rv32emu_phys_write(&m, l0, 4, ((code >> 12) << 10) | 0x4bu));      /* V|R|X|A */
+  assert(rv32emu_phys_write(&m, l0 + 4u, 4, ((data >> 12) << 10) | 0xc7u)); /* V|R|W|A|D */
+  assert(rv32emu_phys_write(&m, code, 4, 0x00052283u));      /* lw x5, 0(x10) */
+  assert(rv32emu_phys_write(&m, code + 4u, 4, 0x00b52223u)); /* sw x11, 4(x10) */
+  assert(rv32emu_phys_write(&m, code + 8u, 4, 0x0000006fu)); /* j . */
+
+  /* Hart 1 caches the data page in its DTLB, then spins on the code page. */
+  m.harts[1].pc = va;
+  m.harts[1].priv = RV32EMU_PRIV_S;
+  m.harts[1].csr[CSR_SATP] = SATP_MODE_SV32 | (root >> 12);
+  m.harts[1].csr[CSR_MHARTID] = 1u;
+  m.harts[1].x[10] = va + 0x1000u;
+  m.harts[1].x[11] = 1u;
+  m.harts[1].running = true;
+  m.cpu.running = false;
+  m.cpu.priv = RV32EMU_PRIV_S;
+
+  setenv("RV32EMU_EXPERIMENTAL_HART_THREADS", "1", 1);
+  assert(pthread_create(&runner, NULL, run_machine_thread, &m) == 0);
+  while (flag == 0u) {
+    assert(rv32emu_phys_read(&m, data + 4u, 4, &flag));
+    sched_yield();
+  }
+  index = ((va + 0x1000u) >> 12) & (m.opts.tlb_entries - 1u);
+  assert(m.harts[1].dtlb[index].valid);
+
+  /* Hart 0 (this thread) fences the page; hart 1 has dropped it by the time the call returns. */
+  rv32emu_bind_thread_hart(&m, 0u);
+  m.cpu.x[17] = SBI_EXT_RFENCE;
+  m.cpu.x[16] = 1u; /* remote_sfence_vma */
+  m.cpu.x[10] = 0x2u;
+  m.cpu.x[11] = 0u;
+  m.cpu.x[12] = va + 0x1000u;
+  m.cpu.x[13] = 0x1000u;
+  assert(rv32emu_handle_sbi_ecall(&m));
+  assert(m.cpu.x[10] == 0u);
+  assert(atomic_load(&m.harts[1].tlb_fence) == 0u);
+  assert(!m.harts[1].dtlb[index].valid);
+  rv32emu_unbind_thread_hart();
+
+  atomic_store(&m.harts[1].running, false);
+  assert(pthread_join(runner, NULL) == 0);
+  unsetenv("RV32EMU_EXPERIMENTAL_HART_THREADS");
+  assert(!atomic_load(&m.harts[1].worker_bound));
+
+  rv32emu_platform_destroy(&m);
+}
+
 static void test_sv32_translate_and_ad_bits(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -311,15 +440,318 @@ static void test_sv32_permission_fault(void) {
   rv32emu_platform_destroy(&m);
 }
 
+static void test_sv32_tlb_hit_and_flush(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x11000u;
+  const uint32_t l0 = RV32EMU_DRAM_BASE + 0x12000u;
+  const uint32_t target_a = RV32EMU_DRAM_BASE + 0x13000u;
+  const uint32_t target_b = RV32EMU_DRAM_BASE + 0x14000u;
+  const uint32_t vaddr = 0x40002000u;
+  const uint32_t vpn1 = (vaddr >> 22) & 0x3ffu;
+  const uint32_t vpn0 = (vaddr >> 12) & 0x3ffu;
+  const uint32_t satp = SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK);
+  uint32_t paddr = 0;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.priv = RV32EMU_PRIV_S;
+
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+
+  assert(rv32emu_translate(&m, vaddr + 0x10u, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a + 0x10u);
+  assert(rv32emu_translate(&m, vaddr + 0x20u, RV32EMU_ACC_STORE, &paddr));
+  assert(paddr == target_a + 0x20u);
+  assert(m.plat.tlb_misses == 1u);
+  assert(m.plat.tlb_hits == 1u);
+
+  /* Toggling SIE keeps the cached translation; SUM changes permissions and drops it. */
+  rv32emu_csr_write(&m, CSR_SSTATUS, rv32emu_csr_read(&m, CSR_SSTATUS) | MSTATUS_SIE);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(m.plat.tlb_misses == 1u && m.plat.tlb_hits == 2u);
+  rv32emu_csr_write(&m, CSR_SSTATUS, rv32emu_csr_read(&m, CSR_SSTATUS) | MSTATUS_SUM);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(m.plat.tlb_misses == 2u && m.plat.tlb_hits == 2u);
+
+  /* Remap without a fence: the stale translation is still architecturally legal. */
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4,
+                            pte_leaf(target_b, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a);
+
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_b);
+
+  /* A trap into M-mode drops the cached translation as well. */
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+  m.cpu.csr[CSR_MTVEC] = RV32EMU_DRAM_BASE;
+  rv32emu_raise_exception(&m, RV32EMU_EXC_ILLEGAL_INST, 0u);
+  m.cpu.priv = RV32EMU_PRIV_S;
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a);
+  rv32emu_platform_destroy(&m);
+
+  rv32emu_default_options(&opts);
+  opts.tlb_entries = 0u;
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.priv = RV32EMU_PRIV_S;
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a);
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4,
+                            pte_leaf(target_b, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_b);
+  assert(m.plat.tlb_hits == 0u && m.plat.tlb_misses == 0u);
+  rv32emu_platform_destroy(&m);
+
+  rv32emu_default_options(&opts);
+  opts.tlb_entries = 48u;
+  assert(!rv32emu_platform_init(&m, &opts));
+}
+
+static void test_sv32_megapage_tlb(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x11000u;
+  const uint32_t vaddr = 0xc0000000u;
+  const uint32_t satp = SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK);
+  uint32_t paddr = 0;
+  uint32_t value = 0;
+  uint32_t live = 0;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.priv = RV32EMU_PRIV_S;
+
+  /* One level-1 leaf maps the first 4 MiB of DRAM; D starts clear. */
+  assert(rv32emu_phys_write(&m, root + (vaddr >> 22) * 4u, 4,
+                            pte_leaf(RV32EMU_DRAM_BASE, PTE_R | PTE_W | PTE_X | PTE_A)));
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+
+  assert(rv32emu_translate(&m, vaddr + 0x1234u, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == RV32EMU_DRAM_BASE + 0x1234u);
+  assert(m.plat.tlb_misses == 1u && m.plat.tlb_hits == 0u);
+
+  /* Other 4 KiB pages of the megapage hit, for fetches too, without using 4 KiB slots. */
+  assert(rv32emu_translate(&m, vaddr + 0x3ff010u, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == RV32EMU_DRAM_BASE + 0x3ff010u);
+  assert(rv32emu_translate(&m, vaddr + 0x200000u, RV32EMU_ACC_FETCH, &paddr));
+  assert(paddr == RV32EMU_DRAM_BASE + 0x200000u);
+  assert(m.plat.tlb_misses == 1u && m.plat.tlb_hits == 2u);
+  for (uint32_t i = 0u; i < opts.tlb_entries; i++) {
+    assert(!m.cpu.itlb[i].valid && !m.cpu.dtlb[i].valid);
+  }
+
+  /* The first store walks once to set D and refills the same entry. */
+  assert(rv32emu_virt_write(&m, vaddr + 0x2000u, 4, RV32EMU_ACC_STORE, 0xcafef00du));
+  assert(rv32emu_virt_write(&m, vaddr + 0x2004u, 4, RV32EMU_ACC_STORE, 0x12345678u));
+  assert(m.plat.tlb_misses == 2u && m.plat.tlb_hits == 3u);
+  assert(rv32emu_phys_read(&m, root + (vaddr >> 22) * 4u, 4, &value));
+  assert((value & PTE_D) != 0u);
+  assert(rv32emu_phys_read(&m, RV32EMU_DRAM_BASE + 0x2004u, 4, &value));
+  assert(value == 0x12345678u);
+  for (uint32_t i = 0u; i < RV32EMU_MTLB_ENTRIES; i++) {
+    live += m.cpu.mtlb[i].valid ? 1u : 0u;
+  }
+  assert(live == 1u);
+
+  /* A page-targeted sfence.vma anywhere inside the megapage drops it. */
+  assert(rv32emu_phys_write(&m, root + (vaddr >> 22) * 4u, 4,
+                            pte_leaf(RV32EMU_DRAM_BASE + 0x400000u, PTE_R | PTE_A)));
+  rv32emu_tlb_flush_page(&m, &m.cpu, vaddr + 0x5000u);
+  assert(rv32emu_translate(&m, vaddr + 0x10u, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == RV32EMU_DRAM_BASE + 0x400010u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_sv32_walk_cache(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x11000u;
+  const uint32_t l0 = RV32EMU_DRAM_BASE + 0x12000u;
+  const uint32_t l0_b = RV32EMU_DRAM_BASE + 0x13000u;
+  const uint32_t target_a = RV32EMU_DRAM_BASE + 0x14000u;
+  const uint32_t target_b = RV32EMU_DRAM_BASE + 0x15000u;
+  const uint32_t vaddr = 0x40002000u;
+  const uint32_t vpn1 = (vaddr >> 22) & 0x3ffu;
+  const uint32_t vpn0 = (vaddr >> 12) & 0x3ffu;
+  const uint32_t satp = SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK);
+  uint32_t paddr = 0;
+  uint32_t pte = 0;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.priv = RV32EMU_PRIV_S;
+  m.cpu.csr[CSR_MTVEC] = RV32EMU_DRAM_BASE;
+
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + vpn0 * 4u, 4, pte_leaf(target_a, PTE_R | PTE_W | PTE_A)));
+  assert(rv32emu_phys_write(&m, l0 + (vpn0 + 1u) * 4u, 4, pte_leaf(target_b, PTE_R | PTE_W)));
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a && m.plat.pwc_hits == 0u);
+
+  /* The neighbouring page only reads its leaf, which still gets A (and D on store). */
+  assert(rv32emu_translate(&m, vaddr + 0x1000u, RV32EMU_ACC_STORE, &paddr));
+  assert(paddr == target_b && m.plat.pwc_hits == 1u);
+  assert(rv32emu_phys_read(&m, l0 + (vpn0 + 1u) * 4u, 4, &pte));
+  assert((pte & (PTE_A | PTE_D)) == (PTE_A | PTE_D));
+
+  /* Privilege-changing traps flush the TLB but keep the walk cache. */
+  rv32emu_raise_exception(&m, RV32EMU_EXC_ILLEGAL_INST, 0u);
+  m.cpu.priv = RV32EMU_PRIV_S;
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a && m.plat.pwc_hits == 2u);
+
+  /* Swapping the level-0 table needs sfence.vma or a satp write to be seen. */
+  assert(rv32emu_phys_write(&m, l0_b + vpn0 * 4u, 4, pte_leaf(target_b, PTE_R | PTE_A)));
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0_b)));
+  rv32emu_tlb_flush_page(&m, &m.cpu, vaddr);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_b && m.plat.pwc_hits == 2u);
+
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  rv32emu_csr_write(&m, CSR_SATP, satp);
+  assert(rv32emu_translate(&m, vaddr, RV32EMU_ACC_LOAD, &paddr));
+  assert(paddr == target_a && m.plat.pwc_hits == 2u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_virt_host_fast_path_and_mmio_fallback(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x15000u;
+  const uint32_t l0 = RV32EMU_DRAM_BASE + 0x16000u;
+  const uint32_t target = RV32EMU_DRAM_BASE + 0x17000u;
+  const uint32_t vaddr_ram = 0x40003000u;
+  const uint32_t vaddr_uart = 0x40004000u;
+  const uint32_t vpn1 = (vaddr_ram >> 22) & 0x3ffu;
+  uint32_t value = 0;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.cpu.priv = RV32EMU_PRIV_S;
+
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + ((vaddr_ram >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_phys_write(&m, l0 + ((vaddr_uart >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(RV32EMU_UART_BASE, PTE_R | PTE_W | PTE_A | PTE_D)));
+  rv32emu_csr_write(&m, CSR_SATP, SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK));
+
+  assert(rv32emu_virt_write(&m, vaddr_ram + 0xffcu, 4, RV32EMU_ACC_STORE, 0x11223344u));
+  assert(rv32emu_virt_write(&m, vaddr_ram + 0x2u, 2, RV32EMU_ACC_STORE, 0xbeefu));
+  assert(rv32emu_virt_write(&m, vaddr_ram + 0x5u, 1, RV32EMU_ACC_STORE, 0x5au));
+  assert(rv32emu_phys_read(&m, target + 0xffcu, 4, &value));
+  assert(value == 0x11223344u);
+  assert(rv32emu_phys_read(&m, target, 4, &value));
+  assert(value == 0xbeef0000u);
+  assert(rv32emu_virt_read(&m, vaddr_ram + 0x4u, 4, RV32EMU_ACC_LOAD, &value));
+  assert(value == 0x00005a00u);
+  assert(rv32emu_virt_read(&m, vaddr_ram + 0x3u, 2, RV32EMU_ACC_LOAD, &value));
+  assert(value == 0x00beu);
+
+  /* UART LSR through a translated page must still reach the device model. */
+  assert(rv32emu_virt_read(&m, vaddr_uart + 5u, 1, RV32EMU_ACC_LOAD, &value));
+  assert((value & 0x60u) == 0x60u);
+
+  rv32emu_platform_destroy(&m);
+}
+
+static void test_virt_unaligned_page_cross(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x18000u;
+  const uint32_t l0 = RV32EMU_DRAM_BASE + 0x19000u;
+  const uint32_t target_a = RV32EMU_DRAM_BASE + 0x1a000u;
+  const uint32_t target_b = RV32EMU_DRAM_BASE + 0x1c000u;
+  const uint32_t target_ro = RV32EMU_DRAM_BASE + 0x1d000u;
+  const uint32_t vaddr = 0x40005000u;
+  const uint32_t vpn1 = (vaddr >> 22) & 0x3ffu;
+  uint32_t value = 0;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.priv = RV32EMU_PRIV_S;
+  m.cpu.csr[CSR_MTVEC] = RV32EMU_DRAM_BASE;
+
+  /* Virtually adjacent pages backed by non-adjacent frames; the third is read-only. */
+  assert(rv32emu_phys_write(&m, root + vpn1 * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + ((vaddr >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_phys_write(&m, l0 + (((vaddr >> 12) + 1u) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_b, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_phys_write(&m, l0 + (((vaddr >> 12) + 2u) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_ro, PTE_R | PTE_A)));
+  rv32emu_csr_write(&m, CSR_SATP, SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK));
+
+  /* Misaligned within one page: one translation, not one per byte. */
+  assert(rv32emu_virt_write(&m, vaddr + 0x101u, 4, RV32EMU_ACC_STORE, 0x11223344u));
+  assert(m.plat.tlb_misses == 1u && m.plat.tlb_hits == 0u);
+  assert(rv32emu_virt_read(&m, vaddr + 0x101u, 4, RV32EMU_ACC_LOAD, &value));
+  assert(value == 0x11223344u);
+  assert(m.plat.tlb_misses == 1u && m.plat.tlb_hits == 1u);
+  assert(rv32emu_phys_read(&m, target_a + 0x100u, 4, &value));
+  assert(value == 0x22334400u);
+
+  /* Page crossing: bytes split across both frames. */
+  assert(rv32emu_virt_write(&m, vaddr + 0xffeu, 4, RV32EMU_ACC_STORE, 0xa1b2c3d4u));
+  assert(rv32emu_phys_read(&m, target_a + 0xffeu, 2, &value));
+  assert(value == 0xc3d4u);
+  assert(rv32emu_phys_read(&m, target_b, 2, &value));
+  assert(value == 0xa1b2u);
+  assert(rv32emu_virt_read(&m, vaddr + 0xfffu, 2, RV32EMU_ACC_LOAD, &value));
+  assert(value == 0xb2c3u);
+
+  /* A fault on the second page reports its first byte and writes nothing. */
+  assert(rv32emu_phys_write(&m, target_b + 0xffcu, 4, 0x55667788u));
+  assert(!rv32emu_virt_write(&m, vaddr + 0x1ffeu, 4, RV32EMU_ACC_STORE, 0xdeadbeefu));
+  assert(m.cpu.csr[CSR_MCAUSE] == RV32EMU_EXC_STORE_PAGE_FAULT);
+  assert(m.cpu.csr[CSR_MTVAL] == vaddr + 0x2000u);
+  assert(rv32emu_phys_read(&m, target_b + 0xffcu, 4, &value));
+  assert(value == 0x55667788u);
+
+  rv32emu_platform_destroy(&m);
+}
+
 static void test_sfence_vma(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
   uint32_t base = RV32EMU_DRAM_BASE + 0x9000u;
+  const uint32_t root = RV32EMU_DRAM_BASE + 0x11000u;
+  const uint32_t l0 = RV32EMU_DRAM_BASE + 0x12000u;
+  const uint32_t target_a = RV32EMU_DRAM_BASE + 0x13000u;
+  const uint32_t target_b = RV32EMU_DRAM_BASE + 0x14000u;
+  const uint32_t va_a = 0x40002000u;
+  const uint32_t va_b = 0x40003000u;
   uint32_t prog[] = {
       0x12000073u, /* sfence.vma x0, x0 */
       enc_addi(14, 0, 3),
       0x00100073u, /* ebreak */
   };
+  uint32_t page_prog[] = {
+      0x12028073u, /* sfence.vma x5, x0 */
+      0x00100073u, /* ebreak */
+  };
+  uint32_t paddr = 0u;
   int steps;
 
   rv32emu_default_options(&opts);
@@ -346,6 +778,38 @@ static void test_sfence_vma(void) {
   assert(m.cpu.csr[CSR_MCAUSE] == RV32EMU_EXC_ILLEGAL_INST);
 
   rv32emu_platform_destroy(&m);
+
+  /* sfence.vma rs1 drops only that page from the TLB and queues a page TB flush. */
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  assert(rv32emu_phys_write(&m, root + ((va_a >> 22) & 0x3ffu) * 4u, 4, pte_ptr(l0)));
+  assert(rv32emu_phys_write(&m, l0 + ((va_a >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_phys_write(&m, l0 + ((va_b >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_b, PTE_R | PTE_W | PTE_A | PTE_D)));
+  rv32emu_csr_write(&m, CSR_SATP, SATP_MODE_SV32 | ((root >> 12) & SATP_PPN_MASK));
+  m.cpu.priv = RV32EMU_PRIV_S;
+  assert(rv32emu_translate(&m, va_a, RV32EMU_ACC_LOAD, &paddr) && paddr == target_a);
+  assert(rv32emu_translate(&m, va_b, RV32EMU_ACC_LOAD, &paddr) && paddr == target_b);
+  assert(rv32emu_phys_write(&m, l0 + ((va_a >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_b, PTE_R | PTE_W | PTE_A | PTE_D)));
+  assert(rv32emu_phys_write(&m, l0 + ((va_b >> 12) & 0x3ffu) * 4u, 4,
+                            pte_leaf(target_a, PTE_R | PTE_W | PTE_A | PTE_D)));
+
+  m.cpu.priv = RV32EMU_PRIV_M;
+  m.cpu.pc = base;
+  m.cpu.x[5] = va_a + 0x44u;
+  write_prog(&m, base, page_prog, (uint32_t)(sizeof(page_prog) / sizeof(page_prog[0])));
+  steps = rv32emu_run(&m, 8);
+  assert(steps == 1);
+  assert(m.cpu.tb_fence == (va_a | RV32EMU_FENCE_PAGE));
+
+  m.cpu.priv = RV32EMU_PRIV_S;
+  assert(rv32emu_translate(&m, va_a, RV32EMU_ACC_LOAD, &paddr) && paddr == target_b);
+  /* va_b was not fenced, so its stale translation is still cached. */
+  assert(rv32emu_translate(&m, va_b, RV32EMU_ACC_LOAD, &paddr) && paddr == target_b);
+
+  rv32emu_platform_destroy(&m);
 }
 
 static void test_m_ext_and_amo(void) {
@@ -363,6 +827,7 @@ static void test_m_ext_and_amo(void) {
       enc_amo(0x00, 2, 6, 5),             /* amoadd.w x5, x2, (x6) */
       enc_amo(0x02, 0, 6, 7),             /* lr.w    x7, (x6) */
       enc_amo(0x03, 1, 6, 8),             /* sc.w    x8, x1, (x6) */
+      enc_amo(0x02, 0, 6, 9),             /* lr.w    x9, (x6) */
       0x00100073u,                        /* ebreak */
   };
   uint32_t value = 0;
@@ -375,7 +840,13 @@ static void test_m_ext_and_amo(void) {
   write_prog(&m, base, prog, (uint32_t)(sizeof(prog) / sizeof(prog[0])));
 
   steps = rv32emu_run(&m, 128);
-  assert(steps == 9);
+  assert(steps == 10);
+  /* sc.w retired the first reservation; the trailing lr.w left one live. */
+  assert(m.plat.lr_live == 1u);
+  assert(rv32emu_virt_write(&m, mem_addr + 4u, 4, RV32EMU_ACC_STORE, 0u));
+  assert(m.plat.lr_live == 1u && m.cpu.lr_valid);
+  assert(rv32emu_virt_write(&m, mem_addr + 2u, 2, RV32EMU_ACC_STORE, 0u));
+  assert(m.plat.lr_live == 0u && !m.cpu.lr_valid);
   assert(m.cpu.x[3] == 42u);
   assert(m.cpu.x[4] == 7u);
   assert(m.cpu.x[5] == 10u);
@@ -388,6 +859,71 @@ static void test_m_ext_and_amo(void) {
   rv32emu_platform_destroy(&m);
 }
 
+static void test_amo_host_atomics_and_mmio_fallback(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+  uint32_t base = RV32EMU_DRAM_BASE + 0xa800u;
+  uint32_t mem_addr = RV32EMU_DRAM_BASE + 0x300u;
+  uint32_t prog[] = {
+      enc_amo(0x1c, 2, 6, 5),  /* amomaxu.w x5, x2, (x6) */
+      enc_amo(0x10, 3, 6, 9),  /* amomin.w  x9, x3, (x6) */
+      enc_amo(0x02, 0, 6, 7),  /* lr.w      x7, (x6) */
+      enc_amo(0x03, 1, 6, 8),  /* sc.w      x8, x1, (x6) */
+      enc_amo(0x08, 2, 4, 10), /* amoor.w   x10, x2, (x4) -> PLIC enable */
+      0x00100073u,             /* ebreak */
+  };
+  uint8_t *host;
+  uint32_t value = 0;
+  uint32_t enable_before;
+  int steps;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.plat.dram_atomic_stats_enable = true;
+  m.cpu.pc = base;
+  m.cpu.x[1] = 0x55u;
+  m.cpu.x[2] = 0x400u;
+  m.cpu.x[3] = 0xfffffff0u; /* -16 */
+  m.cpu.x[4] = RV32EMU_PLIC_BASE + 0x2000u;
+  m.cpu.x[6] = mem_addr;
+  assert(rv32emu_phys_write(&m, mem_addr, 4, 0x20u));
+  enable_before = m.plat.plic_enable[0];
+  write_prog(&m, base, prog, (uint32_t)(sizeof(prog) / sizeof(prog[0])));
+
+  /* DRAM AMOs and lr.w retire as host atomics without touching a mutex. */
+  steps = rv32emu_run(&m, 3);
+  assert(steps == 3);
+  assert(m.cpu.x[5] == 0x20u);
+  assert(m.cpu.x[9] == 0x400u);
+  assert(m.cpu.x[7] == 0xfffffff0u);
+  assert(m.plat.lock_acquires == 0u);
+
+  /*
+   * Change the word behind the reservation without going through the store
+   * invalidation hook: sc.w must still fail because its host CAS compares
+   * against the value lr.w observed.
+   */
+  host = rv32emu_dram_ptr(&m, mem_addr, 4u);
+  assert(host != NULL);
+  __atomic_store_n((uint32_t *)(void *)host, 0x77u, __ATOMIC_SEQ_CST);
+  assert(m.cpu.lr_valid);
+
+  steps = rv32emu_run(&m, 64);
+  assert(steps == 2);
+  assert(m.cpu.x[8] == 1u); /* sc.w failed */
+  assert(!m.cpu.lr_valid && m.plat.lr_live == 0u);
+  assert(rv32emu_phys_read(&m, mem_addr, 4, &value));
+  assert(value == 0x77u);
+
+  /* MMIO AMOs still complete, serialized by the fallback amo_lock. */
+  assert(m.cpu.x[10] == enable_before);
+  assert(m.plat.plic_enable[0] == (enable_before | 0x400u));
+  assert(m.plat.lock_acquires != 0u);
+  assert(m.cpu.csr[CSR_MCAUSE] == RV32EMU_EXC_BREAKPOINT);
+
+  rv32emu_platform_destroy(&m);
+}
+
 static void test_fp_load_store_and_moves(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -704,6 +1240,42 @@ static void test_interrupt_trap_mret(void) {
   rv32emu_platform_destroy(&m);
 }
 
+static void test_interrupt_recheck_flag(void) {
+  rv32emu_machine_t m;
+  rv32emu_options_t opts;
+
+  rv32emu_default_options(&opts);
+  assert(rv32emu_platform_init(&m, &opts));
+  m.cpu.pc = RV32EMU_DRAM_BASE;
+  m.cpu.csr[CSR_MTVEC] = RV32EMU_DRAM_BASE + 0x100u;
+
+  /* Pending but masked: one scan, then the check is a flag test. */
+  rv32emu_raise_interrupt(&m, RV32EMU_IRQ_MSIP);
+  assert(m.cpu.irq_check);
+  assert(!rv32emu_check_pending_interrupt(&m));
+  assert(!m.cpu.irq_check);
+
+  /* Each input to deliverability re-arms the scan. */
+  rv32emu_csr_write(&m, CSR_MIE, MIP_MSIP);
+  assert(m.cpu.irq_check);
+  assert(!rv32emu_check_pending_interrupt(&m));
+  rv32emu_csr_write(&m, CSR_MIDELEG, 0u);
+  assert(m.cpu.irq_check);
+  assert(!rv32emu_check_pending_interrupt(&m));
+  rv32emu_csr_write(&m, CSR_MSTATUS, MSTATUS_MIE);
+  assert(m.cpu.irq_check);
+  assert(rv32emu_check_pending_interrupt(&m));
+  assert(m.cpu.pc == RV32EMU_DRAM_BASE + 0x100u);
+  assert(m.cpu.csr[CSR_MCAUSE] == (0x80000000u | RV32EMU_IRQ_MSIP));
+
+  /* The trap cleared mstatus.MIE, so the rescan finds nothing. */
+  assert(m.cpu.irq_check);
+  assert(!rv32emu_check_pending_interrupt(&m));
+  assert(!m.cpu.irq_check);
+
+  rv32emu_platform_destroy(&m);
+}
+
 static void test_mtvec_vectored_interrupt(void) {
   rv32emu_machine_t m;
   rv32emu_options_t opts;
@@ -835,16 +1407,25 @@ static void test_medeleg_exception_to_s(void) {
 int main(void) {
   test_sbi_shim_handle_and_ecall();
   test_sbi_hsm_start_status();
+  test_sbi_remote_fence();
+  test_sbi_remote_fence_threaded();
   test_sv32_translate_and_ad_bits();
   test_mprv_translate_for_m_mode_data_access();
   test_sv32_permission_fault();
+  test_sv32_tlb_hit_and_flush();
+  test_sv32_megapage_tlb();
+  test_sv32_walk_cache();
+  test_virt_host_fast_path_and_mmio_fallback();
+  test_virt_unaligned_page_cross();
   test_sfence_vma();
   test_m_ext_and_amo();
+  test_amo_host_atomics_and_mmio_fallback();
   test_fp_load_store_and_moves();
   test_compressed_fp_load_store();
   test_csr_alias();
   test_csr_ops();
   test_interrupt_trap_mret();
+  test_interrupt_recheck_flag();
   test_mtvec_vectored_interrupt();
   test_mideleg_interrupt_to_s();
   test_medeleg_exception_to_s();
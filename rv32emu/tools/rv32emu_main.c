@@ -27,6 +27,12 @@ typedef struct {
   uint32_t fw_dynamic_info_addr;
   uint32_t memory_mb;
   uint32_t hart_count;
+  uint32_t tlb_entries;
+  uint32_t timer_batch;
+  rv32emu_mtime_source_t mtime_source;
+  uint32_t timebase_hz;
+  rv32emu_dram_backing_t dram_backing;
+  bool flat_phys;
   uint64_t max_instructions;
   bool has_fw_dynamic_info_addr;
   bool trace;
@@ -53,6 +59,14 @@ static void usage(FILE *out, const char *prog) {
           "  --sbi-shim                  Intercept S-mode SBI ecalls in emulator\n"
           "  --hart-count <num>          Hart count (default 1, max 4)\n"
           "  --memory-mb <num>           RAM size in MiB (default 256)\n"
+          "  --dram-backing <mode>       Guest RAM pages: anon|thp|hugetlb|memfd (default anon)\n"
+          "  --flat-phys                 Map RAM into a 4 GiB guest-physical host window\n"
+          "  --tlb-entries <num>         Per-hart I/D TLB size, pow2 (default 64, 0=off)\n"
+          "  --timer-batch <num>         Max ticks a hart batches before updating mtime "
+          "(default 64, 1=exact)\n"
+          "  --mtime-source <src>        CLINT mtime: instret|host (default instret)\n"
+          "  --timebase-hz <num>         mtime rate for host source, match the DTB "
+          "(default 10000000)\n"
           "  --max-instr <num>           Max instructions (default 50000000)\n"
           "  --interactive               Enable stdin -> UART interactive mode\n"
           "  --trace                     Enable trace flag\n"
@@ -133,6 +147,9 @@ static bool parse_args(int argc, char **argv, cli_options_t *cli) {
   cli->initrd_load_addr = RV32EMU_DEFAULT_INITRD_LOAD;
   cli->hart_count = RV32EMU_DEFAULT_HART_COUNT;
   cli->memory_mb = RV32EMU_DEFAULT_RAM_MB;
+  cli->tlb_entries = RV32EMU_DEFAULT_TLB_ENTRIES;
+  cli->timer_batch = RV32EMU_DEFAULT_TIMER_BATCH;
+  cli->timebase_hz = RV32EMU_DEFAULT_TIMEBASE_HZ;
   cli->max_instructions = RV32EMU_DEFAULT_MAX_INSTR;
   cli->boot_s_mode = true;
   cli->use_fw_dynamic = true;
@@ -167,6 +184,10 @@ static bool parse_args(int argc, char **argv, cli_options_t *cli) {
       cli->use_fw_dynamic = false;
       continue;
     }
+    if (!strcmp(arg, "--flat-phys")) {
+      cli->flat_phys = true;
+      continue;
+    }
 
     if (i + 1 >= argc) {
       fprintf(stderr, "[ERR] missing value for %s\n", arg);
@@ -220,6 +241,48 @@ static bool parse_args(int argc, char **argv, cli_options_t *cli) {
                 RV32EMU_MAX_HARTS);
         return false;
       }
+    } else if (!strcmp(arg, "--dram-backing")) {
+      if (!strcmp(val, "anon")) {
+        cli->dram_backing = RV32EMU_DRAM_BACKING_ANON;
+      } else if (!strcmp(val, "thp")) {
+        cli->dram_backing = RV32EMU_DRAM_BACKING_THP;
+      } else if (!strcmp(val, "hugetlb")) {
+        cli->dram_backing = RV32EMU_DRAM_BACKING_HUGETLB;
+      } else if (!strcmp(val, "memfd")) {
+        cli->dram_backing = RV32EMU_DRAM_BACKING_MEMFD;
+      } else {
+        fprintf(stderr, "[ERR] invalid --dram-backing: %s (use anon|thp|hugetlb|memfd)\n", val);
+        return false;
+      }
+    } else if (!strcmp(arg, "--tlb-entries")) {
+      if (!parse_u32(val, &cli->tlb_entries) || cli->tlb_entries > RV32EMU_TLB_MAX_ENTRIES ||
+          (cli->tlb_entries & (cli->tlb_entries - 1u)) != 0u) {
+        fprintf(stderr, "[ERR] invalid --tlb-entries: %s (power of two, max %u)\n", val,
+                RV32EMU_TLB_MAX_ENTRIES);
+        return false;
+      }
+    } else if (!strcmp(arg, "--timer-batch")) {
+      if (!parse_u32(val, &cli->timer_batch) || cli->timer_batch == 0u ||
+          cli->timer_batch > RV32EMU_TIMER_BATCH_MAX) {
+        fprintf(stderr, "[ERR] invalid --timer-batch: %s (range: 1..%u)\n", val,
+                RV32EMU_TIMER_BATCH_MAX);
+        return false;
+      }
+    } else if (!strcmp(arg, "--mtime-source")) {
+      if (!strcmp(val, "instret")) {
+        cli->mtime_source = RV32EMU_MTIME_INSTRET;
+      } else if (!strcmp(val, "host")) {
+        cli->mtime_source = RV32EMU_MTIME_HOST;
+      } else {
+        fprintf(stderr, "[ERR] invalid --mtime-source: %s (use instret|host)\n", val);
+        return false;
+      }
+    } else if (!strcmp(arg, "--timebase-hz")) {
+      if (!parse_u32(val, &cli->timebase_hz) || cli->timebase_hz == 0u ||
+          cli->timebase_hz > 1000000000u) {
+        fprintf(stderr, "[ERR] invalid --timebase-hz: %s (range: 1..1000000000)\n", val);
+        return false;
+      }
     } else if (!strcmp(arg, "--max-instr")) {
       if (!parse_u64(val, &cli->max_instructions) || cli->max_instructions == 0u) {
         fprintf(stderr, "[ERR] invalid --max-instr: %s\n", val);
@@ -392,6 +455,7 @@ int main(int argc, char **argv) {
   stdin_mode_t stdin_mode;
   uint64_t dram_atomic_read_total;
   uint64_t dram_atomic_write_total;
+  uint64_t lock_acquires;
 
   if (!parse_args(argc, argv, &cli)) {
     usage(stderr, argv[0]);
@@ -404,6 +468,12 @@ int main(int argc, char **argv) {
   opts.enable_sbi_shim = cli.sbi_shim;
   opts.boot_s_mode = cli.boot_s_mode;
   opts.hart_count = cli.hart_count;
+  opts.tlb_entries = cli.tlb_entries;
+  opts.timer_batch = cli.timer_batch;
+  opts.mtime_source = cli.mtime_source;
+  opts.timebase_hz = cli.timebase_hz;
+  opts.dram_backing = cli.dram_backing;
+  opts.flat_phys = cli.flat_phys;
   opts.max_instructions = cli.max_instructions;
   opts.kernel_load_addr = cli.kernel_load_addr;
   opts.dtb_load_addr = cli.dtb_load_addr;
@@ -414,6 +484,12 @@ int main(int argc, char **argv) {
     return 1;
   }
   m.plat.dram_atomic_stats_enable = env_enabled("RV32EMU_DEBUG_DRAM_STATS");
+  if (m.plat.dram_backing != cli.dram_backing) {
+    fprintf(stderr, "[WARN] requested DRAM backing unavailable, using anonymous 4 KiB pages\n");
+  }
+  if (cli.flat_phys && m.plat.phys_window == NULL) {
+    fprintf(stderr, "[WARN] flat physical window unavailable, mapping RAM on its own\n");
+  }
 
   if (!rv32emu_load_image_auto(&m, cli.opensbi_path, cli.opensbi_load_addr, &opensbi_entry,
                                &opensbi_entry_valid)) {
@@ -505,7 +581,15 @@ int main(int argc, char **argv) {
   if (cli.interactive) {
     executed = rv32emu_run_interactive(&m, cli.max_instructions);
   } else {
-    executed = (uint64_t)rv32emu_run(&m, cli.max_instructions);
+    /* Host-clock runs hand control back while every hart is parked in wfi. */
+    while (rv32emu_any_hart_running(&m) && executed < cli.max_instructions) {
+      int delta = rv32emu_run(&m, cli.max_instructions - executed);
+
+      if (delta < 0) {
+        break;
+      }
+      executed += (uint64_t)delta;
+    }
   }
 
   rv32emu_restore_stdin_mode(&stdin_mode);
@@ -553,6 +637,22 @@ int main(int argc, char **argv) {
             ") write_total=%" PRIu64 " (aligned32=%" PRIu64 ", aligned16=%" PRIu64
             ", bytepath=%" PRIu64 ")\n",
             dram_atomic_read_total, r32, r16, rb, dram_atomic_write_total, w32, w16, wb);
+    fprintf(stderr, "[INFO] tlb stats: hits=%" PRIu64 " misses=%" PRIu64 "\n",
+            (uint64_t)atomic_load_explicit(&m.plat.tlb_hits, memory_order_relaxed),
+            (uint64_t)atomic_load_explicit(&m.plat.tlb_misses, memory_order_relaxed));
+    fprintf(stderr,
+            "[INFO] idle stats: warps=%" PRIu64 " skipped_ticks=%" PRIu64
+            " spin_warps=%" PRIu64 " spin_skipped_ticks=%" PRIu64 "\n",
+            (uint64_t)atomic_load_explicit(&m.plat.idle_warps, memory_order_relaxed),
+            (uint64_t)atomic_load_explicit(&m.plat.idle_warp_ticks, memory_order_relaxed),
+            (uint64_t)atomic_load_explicit(&m.plat.spin_warps, memory_order_relaxed),
+            (uint64_t)atomic_load_explicit(&m.plat.spin_warp_ticks, memory_order_relaxed));
+    lock_acquires = atomic_load_explicit(&m.plat.lock_acquires, memory_order_relaxed);
+    fprintf(stderr, "[INFO] lock stats: acquires=%" PRIu64 " contended=%" PRIu64
+            " per_instr=%.4f\n",
+            lock_acquires,
+            (uint64_t)atomic_load_explicit(&m.plat.lock_contended, memory_order_relaxed),
+            executed != 0u ? (double)lock_acquires / (double)executed : 0.0);
   }
 
   if (!rv32emu_any_hart_running(&m) && mcause != RV32EMU_EXC_BREAKPOINT) {